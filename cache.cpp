@@ -0,0 +1,188 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace dp {
+    namespace {
+        /**
+         * @brief Estimate the bytes of a table, see `BasicCache::set_budget`.
+         */
+        template<typename C>
+        std::size_t footprint(BasicDP<C> const& dp) {
+            auto cell = sizeof(C);
+            if constexpr (std::is_same_v<C, Cnt>)
+                cell += sizeof(mp_limb_t)
+                    * mpz_size(path_bound(dp.max_time()).get_mpz_t());
+            return cell * dp.size();
+        }
+    }
+
+    template<typename C>
+    BasicView<C>::BasicView(std::shared_ptr<BasicDP<C> const> dp,
+            Time max_time, std::pair<Loc, Loc> origin): table{std::move(dp)},
+            T{std::move(max_time)} {
+        if (T > table->max_time())
+            throw std::invalid_argument("T is larger than that of the DP.");
+        set_shift(std::move(origin));
+    }
+
+    template<typename C>
+    C BasicView<C>::at(Loc const& i, Loc const& j, Time const& t) const {
+        if (t > T)
+            throw std::invalid_argument("t is larger than T");
+        auto [si, sj] = shift;
+        return table->at(f * (i - si), f * (j - sj), flip ? T - t : t);
+    }
+
+    template<typename C>
+    Time BasicView<C>::max_time() const {
+        return T;
+    }
+
+    template<typename C>
+    void BasicView<C>::flip_time() {
+        flip = !flip;
+    }
+
+    template<typename C>
+    void BasicView<C>::flip_coords() {
+        f *= -1;
+    }
+
+    template<typename C>
+    void BasicView<C>::set_shift(std::pair<Loc, Loc> origin) {
+        auto [i, j] = origin;
+        auto l = std::numeric_limits<Loc>::min() + static_cast<Loc>(T);
+        auto u = std::numeric_limits<Loc>::max() - static_cast<Loc>(T);
+        if (i <= l || j <= l || i >= u || j >= u)
+            throw std::out_of_range("Please shift less.");
+
+        shift = std::move(origin);
+    }
+
+    template<typename C>
+    void BasicCache<C>::evict() {
+        while (used > budget && !entries.empty()) {
+            used -= entries.back().bytes;
+            entries.pop_back();
+        }
+    }
+
+    template<typename C>
+    BasicCache<C>::BasicCache(std::size_t bytes): budget{bytes} {
+        // Intentionally left blank.
+    }
+
+    template<typename C>
+    BasicCache<C>& BasicCache<C>::global() {
+        static BasicCache cache(std::size_t{1} << 30);
+        return cache;
+    }
+
+    template<typename C>
+    void BasicCache<C>::set_budget(std::size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        evict();
+    }
+
+    template<typename C>
+    std::size_t BasicCache<C>::size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+
+    template<typename C>
+    void BasicCache<C>::clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        used = 0;
+    }
+
+    template<typename C>
+    std::shared_ptr<BasicDP<C> const> BasicCache<C>::table(Time max_time,
+            std::unordered_set<Blocked> const& blocked_cells,
+            unsigned threads) {
+        Key key;
+        for (auto const& b: blocked_cells)
+            key.emplace_back(b.i, b.j, b.start);
+        std::sort(key.begin(), key.end());
+        key.erase(std::unique(key.begin(), key.end(), [](auto const& a,
+                auto const& b) {
+                    return std::get<0>(a) == std::get<0>(b)
+                        && std::get<1>(a) == std::get<1>(b);
+                }), key.end());
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->key == key && it->table->max_time() >= max_time) {
+                    entries.splice(entries.begin(), entries, it);
+                    return it->table;
+                }
+            }
+        }
+
+        // Compute without holding the lock, so that other tables can be
+        // served meanwhile; two threads may then compute the same table.
+        std::unordered_set<Blocked> cells;
+        for (auto const& [i, j, s]: key)
+            cells.insert({i, j, s});
+        auto storage = symmetric(cells) ? Storage::octant : Storage::diamond;
+        auto res = std::make_shared<BasicDP<C> const>(max_time, Lazy5{},
+            std::pair<Loc, Loc>{0, 0}, cells, storage, threads);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (it->key == key && it->table->max_time() <= max_time) {
+                used -= it->bytes;
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto bytes = footprint(*res);
+        entries.push_front({std::move(key), res, bytes});
+        used += bytes;
+        evict();
+        return res;
+    }
+
+    template<typename C>
+    BasicView<C> BasicCache<C>::paths(Time max_time,
+            std::pair<Loc, Loc> start,
+            std::unordered_set<Blocked> const& blocked_cells,
+            unsigned threads) {
+        auto [si, sj] = start;
+        std::unordered_set<Blocked> cells;
+        for (auto const& b: blocked_cells)
+            cells.insert({b.i - si, b.j - sj, b.start});
+        return {table(max_time, cells, threads), max_time, std::move(start)};
+    }
+
+    template class BasicView<std::uint64_t>;
+    template class BasicView<Wide>;
+    template class BasicView<Cnt>;
+    template class BasicView<double>;
+
+    template class BasicCache<std::uint64_t>;
+    template class BasicCache<Wide>;
+    template class BasicCache<Cnt>;
+    template class BasicCache<double>;
+}
@@ -0,0 +1,186 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "dp.hpp"
+
+namespace dp {
+    /**
+     * A shifted and flipped view of a shared DP that starts in (0, 0), with
+     * the same access functions as `DP`; copying a view does not copy the
+     * table. The view may use fewer steps than the DP.
+     */
+    template<typename C>
+    class BasicView {
+        /// The DP, neither shifted nor flipped.
+        std::shared_ptr<BasicDP<C> const> table;
+        /// The maximum number of steps, at most that of the DP.
+        Time T;
+        /// Whether we have flipped time.
+        bool flip{false};
+        /// The factor in computing locations, -1 or 1, to flip directions.
+        Loc f{1};
+        /// The shift, i.e. starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift{0, 0};
+
+    public:
+        /**
+         * @brief Initialise a view.
+         * @param dp The DP, neither shifted nor flipped.
+         * @param max_time The value of T, at most that of the DP.
+         * @param origin The shift.
+         */
+        BasicView(std::shared_ptr<BasicDP<C> const> dp, Time max_time,
+            std::pair<Loc, Loc> origin = {0, 0});
+
+        /**
+         * @brief Return the value P(i, j, t), with 0 for unreachable cells,
+         * see `DP::at`.
+         */
+        C at(Loc const& i, Loc const& j, Time const& t) const;
+
+        /**
+         * @brief The value of T.
+         */
+        Time max_time() const;
+
+        /**
+         * @brief Flip the time, see `DP::flip_time`.
+         */
+        void flip_time();
+
+        /**
+         * @brief Flip the coordinates, see `DP::flip_coords`.
+         */
+        void flip_coords();
+
+        /**
+         * @brief Shift the origin, see `DP::set_shift`.
+         */
+        void set_shift(std::pair<Loc, Loc> origin);
+    };
+
+    using View = BasicView<Cnt>;
+
+    /**
+     * A cache of DPs of all paths from (0, 0), keyed by the obstacles relative
+     * to the start, for sharing one table between many start points and
+     * values of T: a DP for T also serves every smaller T. The least
+     * recently used tables are dropped once the tables held take more bytes
+     * than the budget, as estimated by the count type. A dropped table that
+     * a caller still holds stays valid, but is no longer counted, so the
+     * memory in use can exceed the budget by such tables. All functions can
+     * be called from several threads.
+     */
+    template<typename C>
+    class BasicCache {
+        /// The blocked cells relative to the start, sorted, one per cell.
+        using Key = std::vector<std::tuple<Loc, Loc, Time>>;
+
+        /**
+         * A cached table.
+         */
+        struct Entry {
+            /// The obstacles.
+            Key key;
+            /// The DP.
+            std::shared_ptr<BasicDP<C> const> table;
+            /// The estimated size of the DP in bytes.
+            std::size_t bytes;
+        };
+
+        /// The number of bytes to hold at most.
+        std::size_t budget;
+        /// The estimated number of bytes held.
+        std::size_t used{0};
+        /// The tables, the most recently used first.
+        std::list<Entry> entries;
+        /// Guards everything above.
+        mutable std::mutex mutex;
+
+        /**
+         * @brief Drop the least recently used tables until the budget is met.
+         */
+        void evict();
+
+    public:
+        /**
+         * @brief Initialise an empty cache.
+         * @param bytes The number of bytes to hold at most.
+         */
+        explicit BasicCache(std::size_t bytes);
+
+        /**
+         * @brief The cache shared by the whole program, with a budget of 1 GiB
+         * until `set_budget` is called.
+         */
+        static BasicCache& global();
+
+        /**
+         * @brief Change the number of bytes to hold at most. A table takes
+         * sizeof(C) bytes per cell; with `Cnt`, add the limbs of the largest
+         * count, `path_bound(T)`, which overestimates the smaller counts.
+         */
+        void set_budget(std::size_t bytes);
+
+        /**
+         * @brief The estimated number of bytes held, see `set_budget`.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief Drop all tables.
+         */
+        void clear();
+
+        /**
+         * @brief Find or compute the DP of all paths from (0, 0) with at least
+         * T steps; it is stored in octant mode if the obstacles are symmetric.
+         * @param max_time The value of T.
+         * @param blocked_cells The set of blocked cells, relative to (0, 0); a
+         * cell listed several times is blocked from the earliest time.
+         * @param threads The number of threads for computing, see `DP::DP`.
+         * @return The DP, neither shifted nor flipped.
+         */
+        std::shared_ptr<BasicDP<C> const> table(Time max_time,
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            unsigned threads = 1);
+
+        /**
+         * @brief The paths from `start` in T steps, as `all_paths`, from a
+         * cached table.
+         * @param max_time The value of T.
+         * @param start The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param threads The number of threads for computing, see `DP::DP`.
+         * @return A view of the table, shifted to `start`.
+         */
+        BasicView<C> paths(Time max_time, std::pair<Loc, Loc> start,
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            unsigned threads = 1);
+    };
+
+    using Cache = BasicCache<Cnt>;
+}
+#endif
@@ -0,0 +1,667 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "cache.hpp"
+#include "dp.hpp"
+#include "mask.hpp"
+#include "problems.hpp"
+#include "rns.hpp"
+#include "sampler.hpp"
+#include "stencil.hpp"
+#include "stencil_defs.hpp"
+#include "table.hpp"
+
+namespace {
+    /// The number of checks that failed so far.
+    int failed = 0;
+
+    /// The start of most checks, away from (0, 0) to exercise the shifts.
+    std::pair<dp::Loc, dp::Loc> const shifted{3, -2};
+    /// The end of the paths and visits from `shifted`.
+    std::pair<dp::Loc, dp::Loc> const finish{5, -7};
+
+    /**
+     * @brief A wall across the paths from `shifted`, with a gap at i = 1,
+     * from time 2 on.
+     */
+    std::unordered_set<dp::Blocked> wall() {
+        std::unordered_set<dp::Blocked> res;
+        for (dp::Loc i = -4; i <= 4; ++i)
+            if (i != 1)
+                res.emplace(i, 3, 2);
+        return res;
+    }
+
+    /**
+     * @brief A ring around (0, 0) with the corners open, from time 1 on; it
+     * is symmetric, so it works in octant mode.
+     */
+    std::unordered_set<dp::Blocked> ring() {
+        std::unordered_set<dp::Blocked> res;
+        for (dp::Loc k = -2; k <= 2; ++k) {
+            res.emplace(k, 3, 1);
+            res.emplace(k, -3, 1);
+            res.emplace(3, k, 1);
+            res.emplace(-3, k, 1);
+        }
+        return res;
+    }
+
+    /**
+     * @brief Report the outcome of a check, as in the main program.
+     * @param name What was checked.
+     * @param correct Whether the check passed.
+     */
+    void report(std::string const& name, bool correct) {
+        std::cout << name << "... " << (correct ? "correct" : "mismatch")
+            << '\n';
+        failed += !correct;
+    }
+
+    /**
+     * @brief Check if two tables agree on all cells within T steps of a
+     * point at all times up to T, and one step beyond to catch stray values.
+     * @param T The T of both tables.
+     * @param a The first table, with at(i, j, t).
+     * @param b The second table, with at(i, j, t).
+     * @param shift The start point of both tables.
+     */
+    template<typename A, typename B>
+    bool same_tables(dp::Time const& T, A const& a, B const& b,
+            std::pair<dp::Loc, dp::Loc> const& shift) {
+        auto [is, js] = shift;
+        auto sT = static_cast<dp::Loc>(T) + 1;
+        for (dp::Time t = 0; t <= T; ++t)
+            for (dp::Loc i = is - sT; i <= is + sT; ++i)
+                for (dp::Loc j = js - sT; j <= js + sT; ++j)
+                    if (dp::to_cnt(a.at(i, j, t)) != dp::to_cnt(b.at(i, j, t)))
+                        return false;
+        return true;
+    }
+
+    /**
+     * @brief Check if every path starts in `start`, ends in `end` and only
+     * makes the moves of the stencil S.
+     * @param T The number of steps of every path.
+     * @param paths The T + 1 points of every path, one path after another.
+     */
+    template<typename S>
+    bool valid_paths(dp::Time const& T,
+            std::vector<std::pair<dp::Loc, dp::Loc>> const& paths,
+            std::pair<dp::Loc, dp::Loc> const& start,
+            std::pair<dp::Loc, dp::Loc> const& end) {
+        if (paths.empty() || paths.size() % (T + 1) != 0)
+            return false;
+        for (std::size_t p = 0; p < paths.size(); p += T + 1) {
+            if (paths[p] != start || paths[p + T] != end)
+                return false;
+            for (std::size_t k = p; k < p + T; ++k) {
+                bool found = false;
+                for (auto const& m: S::moves)
+                    found |= m.weight > 0
+                        && paths[k + 1].first - paths[k].first == m.di
+                        && paths[k + 1].second - paths[k].second == m.dj;
+                if (!found)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Check if a table is rejected once a word of it is overwritten.
+     * @param path A table written by `write_table`, which is left as it is.
+     * @param at The position of the word, in bytes.
+     * @param word The new value of the word.
+     */
+    bool rejected(std::string const& path, std::streamoff const& at,
+            std::uint64_t const& word) {
+        auto copy = path + ".bad";
+        std::filesystem::copy_file(path, copy,
+            std::filesystem::copy_options::overwrite_existing);
+        {
+            std::fstream f(copy, std::ios::in | std::ios::out
+                | std::ios::binary);
+            f.seekp(at);
+            f.write(reinterpret_cast<char const*>(&word), sizeof(word));
+        }
+        bool thrown = false;
+        try {
+            dp::MappedTable table(copy);
+        } catch (std::runtime_error const&) {
+            thrown = true;
+        }
+        std::filesystem::remove(copy);
+        return thrown;
+    }
+
+    /**
+     * @brief Draw paths with a compiled sampler and check that they are all
+     * the paths of its DP, each about equally often.
+     * @param T The number of steps.
+     * @param paths The DP of the paths from `start`, with the moves of Lazy5.
+     * @param start The start of the paths.
+     * @param end The end of the paths.
+     * @return Whether every drawn path is valid and only goes through cells
+     * that can be reached, every path is drawn, and the chi-square statistic
+     * of the counts is within six standard deviations of its mean.
+     */
+    bool uniform_paths(dp::Time const& T, dp::DP const& paths,
+            std::pair<dp::Loc, dp::Loc> const& start,
+            std::pair<dp::Loc, dp::Loc> const& end) {
+        dp::Sampler sampler(T, paths, end);
+        auto total = paths.at(end.first, end.second, T).get_ui();
+        auto draws = 200 * total;
+        dp::Stream gen(7, 0);
+        std::vector<std::pair<dp::Loc, dp::Loc>> path(T + 1);
+        std::map<std::vector<std::pair<dp::Loc, dp::Loc>>, std::size_t> seen;
+        for (std::size_t k = 0; k < draws; ++k) {
+            sampler.sample(gen, path.data());
+            if (!valid_paths<dp::Lazy5>(T, path, start, end))
+                return false;
+            for (dp::Time t = 0; t <= T; ++t)
+                if (paths.at(path[t].first, path[t].second, t) == 0)
+                    return false;
+            ++seen[path];
+        }
+        double chi2 = 0, mean = static_cast<double>(draws) / total;
+        for (auto const& entry: seen)
+            chi2 += (entry.second - mean) * (entry.second - mean) / mean;
+        // The paths never drawn add `mean` each.
+        chi2 += mean * static_cast<double>(total - seen.size());
+        auto df = static_cast<double>(total - 1);
+        return seen.size() == total && chi2 < df + 6 * std::sqrt(2 * df);
+    }
+
+    /**
+     * @brief A map of 7 x 9 cells, small enough for paths to reach its edge:
+     * a wall across row 4 from time 3 with a gap in column 6, a pillar from
+     * the start and a cell that closes late.
+     */
+    dp::Mask floor_plan() {
+        dp::Mask res(7, 9);
+        for (dp::Loc j = 0; j < 9; ++j)
+            if (j != 6)
+                res.set(4, j, 3);
+        res.set(1, 1, 0);
+        res.set(2, 5, 7);
+        return res;
+    }
+
+    /**
+     * @brief Write a small file for a check.
+     * @param name The name of the file in the temporary directory.
+     * @param bytes The contents.
+     * @return The full name of the file.
+     */
+    std::string write_file(std::string const& name,
+            std::string const& bytes) {
+        auto path = std::filesystem::temp_directory_path().string() + "/"
+            + name;
+        std::ofstream(path, std::ios::binary) << bytes;
+        return path;
+    }
+
+    /**
+     * @brief Check if a map read from a file of 3 x 2 pixels with the
+     * maximum value 1000 holds the times 1000, 0, 5 and 999, 1000, 300.
+     */
+    bool read_map(dp::Mask const& map) {
+        auto never = dp::Mask::never;
+        return map.height() == 2 && map.width() == 3
+            && map.from(0, 0) == never && map.from(0, 1) == 0
+            && map.from(0, 2) == 5 && map.from(1, 0) == 999
+            && map.from(1, 1) == never && map.from(1, 2) == 300
+            && map.from(-1, 0) == 0 && map.from(2, 1) == 0
+            && map.from(0, 3) == 0;
+    }
+
+    /**
+     * @brief Count the walks from a point by following every one of them,
+     * as a DP would count them: each step multiplies by the weight of its
+     * move, and a walk ends on a cell at or after the time it is blocked.
+     * @param T The number of steps.
+     * @param t The number of steps so far.
+     * @param at The point of the walk at time t.
+     * @param weight The product of the weights of the walk so far.
+     * @param since The time from which a cell is blocked.
+     * @param counts The counts, added to for every cell and time.
+     */
+    template<typename S>
+    void follow_walks(dp::Time const& T, dp::Time const& t,
+            std::pair<dp::Loc, dp::Loc> const& at, dp::Cnt const& weight,
+            std::map<std::pair<dp::Loc, dp::Loc>, dp::Time> const& since,
+            std::map<std::tuple<dp::Loc, dp::Loc, dp::Time>, dp::Cnt>&
+            counts) {
+        auto it = since.find(at);
+        if (weight == 0 || (it != since.end() && it->second <= t))
+            return;
+        counts[{at.first, at.second, t}] += weight;
+        if (t < T)
+            for (auto const& m: S::moves)
+                follow_walks<S>(T, t + 1, {at.first + m.di, at.second + m.dj},
+                    weight * m.weight, since, counts);
+    }
+
+    /**
+     * @brief Check the DPs over machine words against `DP`, for counts that
+     * fit.
+     */
+    void check_words() {
+        dp::Time const T = 12;
+        dp::DP paths(T, dp::Lazy5{}, shifted, wall());
+        report("64-bit and 128-bit DPs against DP",
+            same_tables(T, dp::BasicDP<std::uint64_t>(T, dp::Lazy5{},
+                    shifted, wall()), paths, shifted)
+            && same_tables(T, dp::BasicDP<dp::Wide>(T, dp::Lazy5{}, shifted,
+                    wall(), dp::Storage::diamond, 2), paths, shifted));
+    }
+
+    /**
+     * @brief Check the residues of `RnsDP` against the exact counts of `DP`.
+     */
+    void check_rns() {
+        dp::Time const T = 12;
+        report("RnsDP against DP with obstacles",
+            same_tables(T, dp::RnsDP(T, dp::Lazy5{}, shifted, wall()),
+                dp::DP(T, dp::Lazy5{}, shifted, wall()), shifted));
+        report("RnsDP in octant mode against DP",
+            same_tables(T, dp::RnsDP(T, dp::Lazy5{}, {0, 0}, ring(),
+                    dp::Storage::octant), dp::DP(T, dp::Lazy5{}, {0, 0},
+                    ring()), {0, 0}));
+        dp::Time const U = 40;
+        report("visit_all_rns against visit_all",
+            prob::visit_all_rns(U, shifted, finish).flatten(U)
+            == prob::visit_all(U, shifted, finish).flatten(U));
+    }
+
+    /**
+     * @brief Check the fused visit counts against the product DP.
+     */
+    void check_visit_grid() {
+        dp::Time const U = 40;
+        report("visit_grid against visit_all",
+            prob::visit_grid(U, shifted, finish, 2)
+            == prob::visit_all(U, shifted, finish).flatten(U));
+    }
+
+    /**
+     * @brief Check that a batch of paths drawn from a DP is valid.
+     */
+    void check_generate() {
+        dp::Time const U = 40;
+        auto const all = prob::all_paths(U, shifted);
+        report("generate_paths makes valid paths",
+            valid_paths<dp::Lazy5>(U, prob::generate_paths(U, all, finish,
+                    50, 1), shifted, finish)
+            && prob::generate_paths(U, all, finish, 50, 1, 3)
+                == prob::generate_paths(U, all, finish, 50, 1));
+    }
+
+    /**
+     * @brief Check that the compiled sampler draws every path equally often,
+     * with and without obstacles.
+     */
+    void check_sampler() {
+        dp::Time const T = 4;
+        dp::DP paths(T, dp::Lazy5{});
+        report("Sampler draws the 40 paths to (1, 0) uniformly",
+            paths.at(1, 0, T) == 40
+            && uniform_paths(T, paths, {0, 0}, {1, 0}));
+        dp::Time const U = 9;
+        dp::DP blocked(U, dp::Lazy5{}, shifted, wall());
+        report("Sampler draws the paths around a wall uniformly",
+            uniform_paths(U, blocked, shifted, {2, 4}));
+    }
+
+    /**
+     * @brief Check that the paths drawn from checkpoints are valid.
+     */
+    void check_checkpoints() {
+        dp::Time const U = 40;
+        report("generate_paths_checkpointed makes valid paths",
+            valid_paths<dp::Lazy5>(U, prob::generate_paths_checkpointed(U,
+                    shifted, finish, 50, 3, wall()), shifted, finish));
+    }
+
+    /**
+     * @brief Check a table saved in the binary format against its DP, and
+     * that corrupt copies are rejected.
+     */
+    void check_tables() {
+        dp::Time const T = 12;
+        auto file = std::filesystem::temp_directory_path().string()
+            + "/checks-table";
+        dp::DP flipped(T, dp::Lazy5{}, {0, 0}, ring(), dp::Storage::octant);
+        flipped.flip_time();
+        flipped.flip_coords();
+        flipped.set_shift(shifted);
+        flipped.save(file);
+        report("MappedTable against DP",
+            same_tables(T, dp::MappedTable(file), flipped, shifted));
+        std::streamoff spans = 64 + 8 * (T + 1) + 16 * (T + 2);
+        report("MappedTable rejects a bad byte order or index",
+            rejected(file, 48, 0x0807060504030201)
+            && rejected(file, 64 + 16 * (T + 1), 0)
+            && rejected(file, spans + 8, 1u << 20)
+            && rejected(file, spans + 16 * 3, 0x7fffffff00000000));
+        std::filesystem::remove(file);
+    }
+
+    /**
+     * @brief Check the tables of a range of t against `visit_grid`, and that
+     * they only cover the end points with paths.
+     */
+    void check_tables_range() {
+        std::size_t tables = 0, expected = 0;
+        bool correct = true;
+        prob::visit_tables<std::uint64_t>(2, 5, [&](dp::Time const& t,
+                std::pair<dp::Loc, dp::Loc> const& end,
+                dp::BasicGrid<std::uint64_t> const& res) {
+                ++tables;
+                // Every path visits its start, so this is the path count.
+                correct &= res.at(0, 0) > 0 && res
+                    == prob::visit_grid<std::uint64_t>(t, {0, 0}, end);
+            }, {}, 2);
+        for (dp::Loc t = 2; t <= 5; ++t)
+            for (dp::Loc x = 0; x <= t; ++x)
+                for (dp::Loc y = 0; y <= x && x + y <= t; ++y)
+                    ++expected;
+        report("visit_tables against visit_grid",
+            correct && tables == expected);
+    }
+
+    /**
+     * @brief Check that paths drawn from a cached view are those drawn from
+     * the DP itself.
+     */
+    void check_cache() {
+        dp::Time const U = 40;
+        report("generate_paths from a cached view against a DP",
+            prob::generate_paths(U, dp::Cache::global().paths(U, shifted),
+                finish, 50, 4, 2) == prob::generate_paths(U,
+                prob::all_paths(U, shifted), finish, 50, 4));
+    }
+
+    /**
+     * @brief Check the probabilities in floating point against the exact
+     * counts divided by the number of walks.
+     */
+    void check_probabilities() {
+        dp::Time const T = 20;
+        dp::BasicDP<double> const probs(T, dp::Lazy5{}, shifted, wall());
+        dp::DP const paths(T, dp::Lazy5{}, shifted, wall());
+        auto sT = static_cast<dp::Loc>(T) + 1;
+        bool correct = true;
+        for (dp::Time t = 0; t <= T; ++t) {
+            auto walks = dp::path_bound(t);
+            for (dp::Loc i = shifted.first - sT; i <= shifted.first + sT; ++i)
+                for (dp::Loc j = shifted.second - sT;
+                        j <= shifted.second + sT; ++j) {
+                    auto exact = mpq_class(paths.at(i, j, t), walks).get_d();
+                    correct &= std::abs(probs.at(i, j, t) - exact)
+                        <= 1e-12 * exact;
+                }
+        }
+        report("DP in floating point against DP with obstacles", correct);
+
+        dp::Time const U = 40;
+        auto const visits = prob::visit_grid(U, shifted, finish);
+        auto const found = prob::visit_probabilities(U, shifted, finish);
+        auto total = prob::count_paths(U, shifted, finish);
+        auto sU = static_cast<dp::Loc>(U);
+        double largest = 0, error = 0;
+        for (dp::Loc i = shifted.first - sU; i <= shifted.first + sU; ++i)
+            for (dp::Loc j = shifted.second - sU; j <= shifted.second + sU;
+                    ++j) {
+                auto exact = mpq_class(visits.at(i, j), total).get_d();
+                largest = std::max(largest, exact);
+                error = std::max(error, std::abs(found.at(i, j) - exact));
+            }
+        report("visit_probabilities against visit_grid",
+            error <= 1e-12 * largest);
+    }
+
+    /**
+     * @brief Check DPs updated with `reblock` against DPs computed anew.
+     */
+    void check_reblock() {
+        dp::Time const T = 12;
+        dp::DP edited(T, dp::Lazy5{}, shifted, wall());
+        std::unordered_set<dp::Blocked> added{{1, 3, 6}, {-1, -1, 4}};
+        std::unordered_set<dp::Blocked> removed{{-4, 3, 2}, {4, 3, 2}};
+        edited.reblock(dp::Lazy5{}, added, removed);
+        auto moved = wall();
+        for (auto const& cell: removed)
+            moved.erase(cell);
+        moved.insert(added.begin(), added.end());
+        report("reblock against a new DP",
+            same_tables(T, edited, dp::DP(T, dp::Lazy5{}, shifted, moved),
+                shifted));
+        dp::DP octant(T, dp::Lazy5{}, {0, 0}, ring(), dp::Storage::octant,
+            2);
+        octant.reblock(dp::Lazy5{}, {}, ring(), 2);
+        report("reblock in octant mode against a new DP",
+            same_tables(T, octant, dp::DP(T, dp::Lazy5{}), {0, 0}));
+    }
+
+    /**
+     * @brief Check DPs on a map against DPs with the same blocked cells, and
+     * maps read from PGM files.
+     */
+    void check_mask() {
+        dp::Time const T = 12;
+        auto const map = floor_plan();
+        std::pair<dp::Loc, dp::Loc> const origin{2, 3};
+        std::unordered_set<dp::Blocked> cells;
+        auto sT = static_cast<dp::Loc>(T) + 1;
+        for (dp::Loc i = origin.first - sT; i <= origin.first + sT; ++i)
+            for (dp::Loc j = origin.second - sT; j <= origin.second + sT; ++j)
+                if (map.from(i, j) != dp::Mask::never)
+                    cells.emplace(i, j, map.from(i, j));
+        dp::DP const paths(T, dp::Lazy5{}, origin, cells);
+        report("DP on a map against DP with its blocked cells",
+            same_tables(T, dp::DP(T, dp::Lazy5{}, map, origin), paths, origin)
+            && same_tables(T, dp::DP(T, dp::Lazy5{}, map, origin, 3), paths,
+                origin));
+
+        bool thrown = false;
+        try {
+            dp::DP blocked(T, dp::Lazy5{}, map, {1, 1});
+        } catch (std::invalid_argument const&) {
+            thrown = true;
+        }
+        report("DP on a map rejects a blocked origin", thrown);
+
+        auto plain = write_file("checks-plain.pgm",
+            "P2\n# 3 x 2\n3 2\n1000\n1000 0 5\n999 1000 300\n");
+        std::string pixels;
+        for (unsigned v: {1000u, 0u, 5u, 999u, 1000u, 300u}) {
+            pixels += static_cast<char>(v >> 8);
+            pixels += static_cast<char>(v & 255);
+        }
+        auto binary = write_file("checks-binary.pgm", "P5 3 2 1000\n"
+            + pixels);
+        report("Maps read from PGM files",
+            read_map(dp::Mask::read_pgm(plain))
+            && read_map(dp::Mask::read_pgm(binary)));
+        std::filesystem::remove(plain);
+        std::filesystem::remove(binary);
+    }
+
+    /**
+     * @brief Check DPs that only store the cells within reach against
+     * diamond storage.
+     */
+    void check_reachable() {
+        dp::Time const T = 12;
+        // The ring with its corners closed, which the paths cannot leave.
+        auto box = ring();
+        for (dp::Loc i: {-3, 3})
+            for (dp::Loc j: {-3, 3})
+                box.emplace(i, j, 1);
+        bool correct = true;
+        for (unsigned threads: {1u, 3u})
+            correct &= same_tables(T, dp::DP(T, dp::Lazy5{}, shifted, wall(),
+                    dp::Storage::reachable, threads),
+                dp::DP(T, dp::Lazy5{}, shifted, wall()), shifted)
+                && same_tables(T, dp::DP(T, dp::Lazy5{}, {0, 0}, ring(),
+                    dp::Storage::reachable, threads),
+                dp::DP(T, dp::Lazy5{}, {0, 0}, ring()), {0, 0})
+                && same_tables(T, dp::DP(T, dp::Lazy5{}, {0, 0}, box,
+                    dp::Storage::reachable, threads),
+                dp::DP(T, dp::Lazy5{}, {0, 0}, box), {0, 0});
+        report("Storage::reachable against Storage::diamond", correct);
+    }
+
+    /**
+     * @brief Check the other stencils across the backends and the paths.
+     */
+    void check_stencils() {
+        dp::Time const T = 12;
+        report("RnsDP against DP for King8",
+            same_tables(T, dp::RnsDP(T, dp::King8{}, shifted, wall()),
+                dp::DP(T, dp::King8{}, shifted, wall()), shifted));
+        report("128-bit DP against DP for Lazy9",
+            same_tables(T, dp::BasicDP<dp::Wide>(T, dp::Lazy9{}, shifted,
+                    wall(), dp::Storage::diamond, 2),
+                dp::DP(T, dp::Lazy9{}, shifted, wall()), shifted));
+        using Drift = dp::Weighted5<2, 3, 1, 1, 1>;
+        dp::Time const V = 8;
+        std::map<std::pair<dp::Loc, dp::Loc>, dp::Time> since;
+        for (auto const& b: wall())
+            since[{b.i, b.j}] = b.start;
+        std::map<std::tuple<dp::Loc, dp::Loc, dp::Time>, dp::Cnt> walks;
+        follow_walks<Drift>(V, 0, shifted, 1, since, walks);
+        dp::DP const drift(V, Drift{}, shifted, wall());
+        bool correct = true;
+        auto sV = static_cast<dp::Loc>(V) + 1;
+        for (dp::Time t = 0; t <= V; ++t)
+            for (dp::Loc i = shifted.first - sV; i <= shifted.first + sV; ++i)
+                for (dp::Loc j = shifted.second - sV;
+                        j <= shifted.second + sV; ++j) {
+                    auto it = walks.find({i, j, t});
+                    correct &= drift.at(i, j, t)
+                        == (it == walks.end() ? 0 : it->second);
+                }
+        report("DP for Weighted5 against following every walk", correct);
+        dp::Time const U = 40;
+        report("generate_paths makes valid paths for King8",
+            valid_paths<dp::King8>(U, prob::generate_paths<dp::Cnt,
+                    dp::King8>(U, prob::all_paths<dp::Cnt, dp::King8>(U,
+                    shifted), finish, 50, 2), shifted, finish));
+    }
+
+    /**
+     * @brief Check the visit counts of a batch of gaps with different T
+     * against `visit_grid` for each gap.
+     */
+    void check_batch() {
+        std::vector<prob::Gap> gaps{{shifted, finish, 40}, {shifted, finish,
+            13}, {{0, 0}, {2, 1}, 9}, {{-4, 6}, {-4, 6}, 6}, {shifted,
+            {3, 1}, 21}, {{1, 1}, {-2, 3}, 5}};
+        std::vector<bool> correct(gaps.size(), false);
+        prob::visit_batch<dp::Wide>(gaps, [&](std::size_t k,
+                dp::BasicGrid<dp::Wide> const& res) {
+                correct[k] = res == prob::visit_grid<dp::Wide>(gaps[k].T,
+                    gaps[k].start, gaps[k].end);
+            }, {}, 3);
+        report("visit_batch against visit_grid",
+            std::find(correct.begin(), correct.end(), false)
+            == correct.end());
+    }
+
+    /**
+     * @brief Check the layers computed with transforms against `DP`.
+     */
+    void check_layer() {
+        dp::Time const U = 40;
+        auto const all = prob::all_paths(U, shifted);
+        bool correct = true;
+        for (dp::Time t: {0u, 1u, 2u, 7u, 40u}) {
+            auto const layer = dp::rns_layer(t, shifted, 2);
+            auto st = static_cast<dp::Loc>(t) + 1;
+            for (dp::Loc i = shifted.first - st; i <= shifted.first + st; ++i)
+                for (dp::Loc j = shifted.second - st;
+                        j <= shifted.second + st; ++j)
+                    correct &= layer.at(i, j) == all.at(i, j, t);
+        }
+        report("rns_layer against DP", correct);
+    }
+
+    /**
+     * @brief Check the counts for single cells against `DP`.
+     */
+    void check_count() {
+        dp::Time const U = 40;
+        auto const all = prob::all_paths(U, shifted);
+        bool correct = true;
+        for (dp::Time t: {0u, 1u, 2u, 7u, 40u}) {
+            auto st = static_cast<dp::Loc>(t) + 1;
+            for (dp::Loc i = shifted.first - st; i <= shifted.first + st; ++i)
+                for (dp::Loc j = shifted.second - st;
+                        j <= shifted.second + st; ++j)
+                    correct &= prob::count_paths(t, shifted, {i, j})
+                        == all.at(i, j, t);
+        }
+        report("count_paths against DP", correct);
+    }
+
+    /**
+     * @brief Check the visit counts with a DP spilled to disk against those
+     * in memory.
+     */
+    void check_spill() {
+        dp::Time const U = 40;
+        auto dir = std::filesystem::temp_directory_path().string();
+        report("visit_grid_spilled against visit_grid",
+            prob::visit_grid_spilled(U, shifted, finish, dir)
+                == prob::visit_grid(U, shifted, finish)
+            && prob::visit_grid_spilled<dp::Wide>(U, shifted, finish, dir)
+                == prob::visit_grid<dp::Wide>(U, shifted, finish));
+    }
+}
+
+int main() {
+    check_words();
+    check_rns();
+    check_visit_grid();
+    check_generate();
+    check_sampler();
+    check_checkpoints();
+    check_tables();
+    check_tables_range();
+    check_cache();
+    check_probabilities();
+    check_reblock();
+    check_mask();
+    check_reachable();
+    check_stencils();
+    check_batch();
+    check_layer();
+    check_count();
+    check_spill();
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
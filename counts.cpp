@@ -0,0 +1,78 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "counts.hpp"
+
+#include <mutex>
+
+namespace dp {
+    Cnt Count<std::uint64_t>::to_cnt(std::uint64_t const& a) {
+        static_assert(sizeof(unsigned long) == sizeof(std::uint64_t));
+        return Cnt(static_cast<unsigned long>(a));
+    }
+
+    Cnt Count<std::uint64_t>::max() {
+        return to_cnt(std::numeric_limits<std::uint64_t>::max());
+    }
+
+    Cnt Count<Wide>::to_cnt(Wide const& a) {
+        Cnt res = Count<std::uint64_t>::to_cnt(static_cast<std::uint64_t>(
+            a >> 64));
+        res <<= 64;
+        res += Count<std::uint64_t>::to_cnt(static_cast<std::uint64_t>(a));
+        return res;
+    }
+
+    Cnt Count<Wide>::max() {
+        return to_cnt(~Wide{0});
+    }
+
+    Cnt Count<Cnt>::to_cnt(Cnt const& a) {
+        return a;
+    }
+
+    Cnt path_bound(Time const& T, unsigned weight) {
+        Cnt res;
+        mpz_ui_pow_ui(res.get_mpz_t(), weight, T);
+        return res;
+    }
+
+    Factorials& Factorials::global() {
+        static Factorials factorials;
+        return factorials;
+    }
+
+    void Factorials::reserve(Time const& n) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            if (n < table.size())
+                return;
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        table.reserve(std::size_t{n} + 1);
+        while (table.size() <= n)
+            table.push_back(table.back() * table.size());
+    }
+
+    Cnt Factorials::binomial(Time const& n, Time const& k) {
+        if (k > n)
+            return 0;
+        reserve(n);
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        Cnt res;
+        mpz_divexact(res.get_mpz_t(), table[n].get_mpz_t(),
+            table[k].get_mpz_t());
+        mpz_divexact(res.get_mpz_t(), res.get_mpz_t(),
+            table[n - k].get_mpz_t());
+        return res;
+    }
+}
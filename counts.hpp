@@ -0,0 +1,419 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COUNTS_H
+#define COUNTS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+#include <gmpxx.h>
+#include "defs.hpp"
+
+namespace dp {
+    /// Unsigned 128-bit counts.
+    __extension__ typedef unsigned __int128 Wide;
+
+    /**
+     * Arithmetic on the count types that the DP can be instantiated with:
+     * `std::uint64_t` and `Wide` (exact as long as the counts fit), and
+     * `Cnt` (always exact).
+     */
+    template<typename C>
+    struct Count;
+
+    template<>
+    struct Count<std::uint64_t> {
+        /**
+         * @brief Add b to a in place.
+         */
+        static void add(std::uint64_t& a, std::uint64_t const& b) {
+            a += b;
+        }
+
+        /**
+         * @brief Add b * c to a in place.
+         */
+        static void add_mul(std::uint64_t& a, std::uint64_t const& b,
+                std::uint64_t const& c) {
+            a += b * c;
+        }
+
+        /**
+         * @brief Convert a count to `Cnt`.
+         */
+        static Cnt to_cnt(std::uint64_t const& a);
+
+        /**
+         * @brief The largest count that can be represented.
+         */
+        static Cnt max();
+
+        /**
+         * @brief The number of 64-bit words a count needs, see `put`.
+         */
+        static std::size_t words(std::uint64_t const&) {
+            return 1;
+        }
+
+        /**
+         * @brief Write a count as `width` words, the least significant first,
+         * as in the binary tables and the spilled layers.
+         */
+        static void put(std::uint64_t const& a, std::uint64_t* out,
+                std::size_t) {
+            out[0] = a;
+        }
+
+        /**
+         * @brief Read a count from `width` words, the least significant first.
+         */
+        static void get(std::uint64_t& a, std::uint64_t const* in,
+                std::size_t) {
+            a = in[0];
+        }
+
+        /**
+         * @brief Draw a count uniformly at random from [0, n).
+         * @param n The bound, positive.
+         * @param gen The generator of uniform 64-bit words.
+         */
+        template<typename Gen>
+        static std::uint64_t draw(std::uint64_t const& n, Gen& gen) {
+            static_assert(Gen::min() == 0 && Gen::max()
+                == std::numeric_limits<std::uint64_t>::max(),
+                "Gen should produce 64-bit words.");
+            auto mask = n - 1;
+            for (unsigned s = 1; s < 64; s *= 2)
+                mask |= mask >> s;
+            std::uint64_t res;
+            do {
+                res = gen() & mask;
+            } while (res >= n);
+            return res;
+        }
+    };
+
+    template<>
+    struct Count<Wide> {
+        /**
+         * @brief Add b to a in place.
+         */
+        static void add(Wide& a, Wide const& b) {
+            a += b;
+        }
+
+        /**
+         * @brief Add b * c to a in place.
+         */
+        static void add_mul(Wide& a, Wide const& b, Wide const& c) {
+            a += b * c;
+        }
+
+        /**
+         * @brief Convert a count to `Cnt`.
+         */
+        static Cnt to_cnt(Wide const& a);
+
+        /**
+         * @brief The largest count that can be represented.
+         */
+        static Cnt max();
+
+        /**
+         * @brief The number of 64-bit words a count needs, see `put`.
+         */
+        static std::size_t words(Wide const&) {
+            return 2;
+        }
+
+        /**
+         * @brief Write a count as `width` words, the least significant first.
+         */
+        static void put(Wide const& a, std::uint64_t* out, std::size_t) {
+            out[0] = static_cast<std::uint64_t>(a);
+            out[1] = static_cast<std::uint64_t>(a >> 64);
+        }
+
+        /**
+         * @brief Read a count from `width` words, the least significant first.
+         */
+        static void get(Wide& a, std::uint64_t const* in, std::size_t) {
+            a = static_cast<Wide>(in[1]) << 64 | in[0];
+        }
+
+        /**
+         * @brief Draw a count uniformly at random from [0, n).
+         * @param n The bound, positive.
+         * @param gen The generator of uniform 64-bit words.
+         */
+        template<typename Gen>
+        static Wide draw(Wide const& n, Gen& gen) {
+            static_assert(Gen::min() == 0 && Gen::max()
+                == std::numeric_limits<std::uint64_t>::max(),
+                "Gen should produce 64-bit words.");
+            auto mask = n - 1;
+            for (unsigned s = 1; s < 128; s *= 2)
+                mask |= mask >> s;
+            Wide res;
+            do {
+                res = static_cast<Wide>(gen()) << 64;
+                res = (res | gen()) & mask;
+            } while (res >= n);
+            return res;
+        }
+    };
+
+    static_assert(GMP_LIMB_BITS == 64,
+        "Counts are written to 64-bit words limb by limb.");
+
+    template<>
+    struct Count<Cnt> {
+        /**
+         * @brief Add b to a in place, without temporaries.
+         */
+        static void add(Cnt& a, Cnt const& b) {
+            mpz_add(a.get_mpz_t(), a.get_mpz_t(), b.get_mpz_t());
+        }
+
+        /**
+         * @brief Add b * c to a in place, without temporaries.
+         */
+        static void add_mul(Cnt& a, Cnt const& b, Cnt const& c) {
+            mpz_addmul(a.get_mpz_t(), b.get_mpz_t(), c.get_mpz_t());
+        }
+
+        /**
+         * @brief Add b * c to a in place for a word c, without temporaries.
+         */
+        static void add_mul(Cnt& a, Cnt const& b, unsigned long c) {
+            mpz_addmul_ui(a.get_mpz_t(), b.get_mpz_t(), c);
+        }
+
+        /**
+         * @brief Convert a count to `Cnt`.
+         */
+        static Cnt to_cnt(Cnt const& a);
+
+        /**
+         * @brief The number of 64-bit words a count needs, see `put`.
+         */
+        static std::size_t words(Cnt const& a) {
+            return mpz_size(a.get_mpz_t());
+        }
+
+        /**
+         * @brief Write a count as `width` words, the least significant first;
+         * `width` is at least `words(a)`.
+         */
+        static void put(Cnt const& a, std::uint64_t* out,
+                std::size_t width) {
+            std::fill(out, out + width, 0);
+            mpz_export(out, nullptr, -1, sizeof(std::uint64_t), 0, 0,
+                a.get_mpz_t());
+        }
+
+        /**
+         * @brief Read a count from `width` words, the least significant first.
+         */
+        static void get(Cnt& a, std::uint64_t const* in, std::size_t width) {
+            mpz_import(a.get_mpz_t(), width, -1, sizeof(std::uint64_t), 0, 0,
+                in);
+        }
+
+        /**
+         * @brief Draw a count uniformly at random from [0, n).
+         * @param n The bound, positive.
+         * @param gen The generator of uniform 64-bit words.
+         */
+        template<typename Gen>
+        static Cnt draw(Cnt const& n, Gen& gen) {
+            static_assert(Gen::min() == 0 && Gen::max()
+                == std::numeric_limits<std::uint64_t>::max(),
+                "Gen should produce 64-bit words.");
+            auto bits = mpz_sizeinbase(n.get_mpz_t(), 2);
+            std::vector<std::uint64_t> words((bits + 63) / 64);
+            auto top = bits % 64 == 0 ? ~std::uint64_t{0}
+                : (std::uint64_t{1} << bits % 64) - 1;
+            Cnt res;
+            do {
+                for (auto& w: words)
+                    w = gen();
+                words.back() &= top;
+                mpz_import(res.get_mpz_t(), words.size(), -1, sizeof(words[0]),
+                    0, 0, words.data());
+            } while (res >= n);
+            return res;
+        }
+    };
+
+    /**
+     * Probabilities instead of counts: a DP over `double` built from a
+     * stencil divides every layer by the total weight of the moves, so that
+     * its cells hold the probability that the walk is there (and has not hit
+     * an obstacle), e.g. the count divided by 5^t for `Lazy5`. These never
+     * overflow, and the inner loops vectorise; cells with less than `DBL_MIN`
+     * are set to 0, so only counts that are negligible next to 5^t are lost.
+     */
+    template<>
+    struct Count<double> {
+        /**
+         * @brief Add b to a in place.
+         */
+        static void add(double& a, double const& b) {
+            a += b;
+        }
+
+        /**
+         * @brief Add b * c to a in place.
+         */
+        static void add_mul(double& a, double const& b, double const& c) {
+            a += b * c;
+        }
+
+        /**
+         * @brief Multiply n cells by w in place, flushing those that become
+         * subnormal to 0 to keep the arithmetic fast.
+         */
+        static void scale(double* cells, std::size_t n, double const& w) {
+            for (std::size_t k = 0; k < n; ++k) {
+                auto x = cells[k] * w;
+                cells[k] = x < std::numeric_limits<double>::min() ? 0. : x;
+            }
+        }
+    };
+
+    /**
+     * A counter-based generator of 64-bit words (SplitMix64): the stream is
+     * fixed by a seed and an index, so that, e.g., every trajectory of a batch
+     * can have its own stream without any state shared between threads.
+     */
+    class Stream {
+        /// The increment of the counter, the golden ratio in 64 bits.
+        static constexpr std::uint64_t gamma = 0x9e3779b97f4a7c15;
+        /// The counter.
+        std::uint64_t state;
+
+        /**
+         * @brief Scramble the bits of a word.
+         */
+        static std::uint64_t mix(std::uint64_t z) {
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            return z ^ (z >> 31);
+        }
+
+    public:
+        using result_type = std::uint64_t;
+
+        /**
+         * @brief Start stream `id` for `seed`.
+         */
+        Stream(std::uint64_t seed, std::uint64_t id): state{mix(seed
+                ^ mix(id * gamma + 1))} {
+            // Intentionally left blank.
+        }
+
+        static constexpr result_type min() {
+            return 0;
+        }
+
+        static constexpr result_type max() {
+            return std::numeric_limits<result_type>::max();
+        }
+
+        result_type operator()() {
+            state += gamma;
+            return mix(state);
+        }
+    };
+
+    /**
+     * @brief Convert a count of any supported type to `Cnt`.
+     */
+    template<typename C>
+    Cnt to_cnt(C const& a) {
+        return Count<C>::to_cnt(a);
+    }
+
+    /**
+     * @brief The number of paths of the uniform walk with T steps, 5^T, which
+     * bounds every count in a DP for T.
+     * @param T The number of steps.
+     * @param weight The number of paths of one step, for other stencils, see
+     * `stencil_weight`.
+     */
+    Cnt path_bound(Time const& T, unsigned weight = 5);
+
+    /**
+     * The factorials 0!, 1!, ..., computed as far as needed and kept for
+     * later calls, for exact binomial coefficients of any size. All
+     * functions can be called from several threads.
+     */
+    class Factorials {
+        /// The factorials computed so far, k! at k.
+        std::vector<Cnt> table{1};
+        /// Guards `table`: shared for reading, unique for extending.
+        mutable std::shared_mutex mutex;
+
+    public:
+        /**
+         * @brief The table shared by the whole program.
+         */
+        static Factorials& global();
+
+        /**
+         * @brief Make sure that the factorials up to n! are computed.
+         */
+        void reserve(Time const& n);
+
+        /**
+         * @brief The binomial coefficient n choose k, 0 if k > n.
+         */
+        Cnt binomial(Time const& n, Time const& k);
+    };
+
+    /**
+     * A count type passed as a value, see `with_count`.
+     */
+    template<typename C>
+    struct Tag {
+        using type = C;
+    };
+
+    /**
+     * @brief Call f with `Tag<C>{}` for the narrowest count type C that can
+     * represent all counts up to `bound` exactly.
+     *
+     * For example, for a DP with T steps:
+     *   with_count(path_bound(T), [&](auto tag) {
+     *       using C = typename decltype(tag)::type;
+     *       auto paths = prob::all_paths<C>(T, {0, 0});
+     *   });
+     * @param bound The largest count that needs to be represented.
+     * @param f The function, generic in its argument.
+     * @return Whatever f returns; it should be the same for all count types.
+     */
+    template<typename F>
+    decltype(auto) with_count(Cnt const& bound, F&& f) {
+        if (bound <= Count<std::uint64_t>::max())
+            return std::forward<F>(f)(Tag<std::uint64_t>{});
+        if (bound <= Count<Wide>::max())
+            return std::forward<F>(f)(Tag<Wide>{});
+        return std::forward<F>(f)(Tag<Cnt>{});
+    }
+}
+#endif
@@ -12,46 +12,43 @@
 
 #include "dp.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdlib>
 #include <limits>
 #include <stdexcept>
+#include <type_traits>
+#include "stencil_defs.hpp"
+#include "table.hpp"
 
 namespace dp {
-    Blocked::Blocked(Loc x, Loc y, Time s): i{std::move(x)}, j{std::move(y)},
-            start{std::move(s)} {
-        // Intentionally left blank.
-    }
-
-    bool Blocked::operator==(Blocked const& o) const {
-        return i == o.i && j == o.j;
-    }
-
-    bool DP::test_index(Loc const& i, Loc const& j, Time const& t) const {
-        auto ts = static_cast<Loc>(T);
+    template<typename C>
+    bool BasicDP<C>::test_index(Loc const& i, Loc const& j,
+            Time const& t) const {
+        if (t > T)
+            return false;
         auto [si, sj] = shift;
-        Blocked test(i, j, 0);
-        auto loc = blocked.find(test);
         auto tf = flip ? T - t : t;
-        Loc is = f * (i - si) + ts, js = f * (j - sj) + ts;
-        return t <= T && is >= 0 && js >= 0
-            && static_cast<Time>(is) <= 2 * T && static_cast<Time>(js) <= 2 * T
-            && (loc == blocked.end() || tf < loc->start);
+        Loc is = f * (i - si), js = f * (j - sj);
+        return layout.offset(is, js, tf) != Layout::npos
+            && !blocked.blocked(is, js, tf);
     }
 
-    std::size_t DP::index(Loc const& i, Loc const& j, Time const& t) const {
+    template<typename C>
+    std::size_t BasicDP<C>::index(Loc const& i, Loc const& j,
+            Time const& t) const {
         assert(t <= T);
-        auto ts = static_cast<Loc>(T);
         auto [si, sj] = shift;
-        Loc is = f * (i - si) + ts, js = f * (j - sj) + ts;
+        Loc is = f * (i - si), js = f * (j - sj);
         auto tf = flip ? T - t : t;
-        std::size_t ret = tf * (2 * T + 1) * (2 * T + 1);
-        ret += static_cast<std::size_t>(is) * (2 * T + 1);
-        ret += static_cast<std::size_t>(js);
-        return ret;
+        auto offset = layout.offset(is, js, tf);
+        assert(offset != Layout::npos);
+        return layout.layer_begin(tf) + offset;
     }
 
-    Cnt& DP::at(Loc const& i, Loc const& j, Time const& t) {
+    template<typename C>
+    C& BasicDP<C>::at(Loc const& i, Loc const& j, Time const& t) {
         if (t > T)
             throw std::invalid_argument("t is larger than T");
         if (!test_index(i, j, t))
@@ -59,54 +56,84 @@ namespace dp {
         return table[index(i, j, t)];
     }
 
-    Cnt DP::at(Loc const& i, Loc const& j, Time const& t) const {
+    template<typename C>
+    C BasicDP<C>::at(Loc const& i, Loc const& j, Time const& t) const {
         if (t > T)
             throw std::invalid_argument("t is larger than T");
-        return test_index(i, j, t) ? table[index(i, j, t)] : 0;
-    }
-
-    DP::DP(Time max_time, std::function<Cnt(DP const&, Loc const&, Loc const&,
-            Time const&)> propagate, std::pair<Loc, Loc> origin,
-            std::unordered_set<Blocked> const& blocked_cells):
-            T{std::move(max_time)}, table((T + 1) * (2 * T + 1) * (2 * T + 1)) {
-        if (T > std::numeric_limits<Loc>::max())
-            throw std::length_error("Please pick a lower value of T.");
-
-        auto [is, js] = origin;
-        for (auto const& cell: blocked_cells)
-            blocked.emplace(cell.i - is, cell.j - js, cell.start);
-
-        Loc Ts = static_cast<Loc>(T);
-        for (Loc i = -Ts; i <= Ts; ++i) {
-            for (Loc j = -Ts; j <= Ts; ++j) {
-                auto loc = blocked.find(Blocked(i, j, 0));
-                if (loc == blocked.end() || loc->start > 0)
-                    at(i, j, 0) = (i == 0 && j == 0) ? 1 : 0;
-            }
-        }
+        return test_index(i, j, t) ? table[index(i, j, t)] : C{0};
+    }
+
+    template<typename C>
+    std::size_t BasicDP<C>::band_offset(Time const& t, Loc const& i) const {
+        return i > layout.last_row(t) ? layout.layer_size(t)
+            : layout.row(i, t).offset;
+    }
+
+    template<typename C>
+    void BasicDP<C>::init() {
+        if (layout.folded() && !blocked.symmetric())
+            throw std::invalid_argument("Obstacles are not symmetric.");
 
+        if (!blocked.blocked(0, 0, 0))
+            at(0, 0, 0) = 1;
+    }
+
+    template<typename C>
+    BasicDP<C>::BasicDP(Time max_time, std::function<C(BasicDP const&,
+            Loc const&, Loc const&, Time const&)> propagate,
+            std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells, Storage storage,
+            unsigned threads): T{std::move(max_time)},
+            blocked(T, blocked_cells, origin),
+            layout{Layout::make(storage, T)}, table(layout.size()) {
+        init();
+        Pool pool(threads);
         for (Time t = 0; t < T; ++t) {
-            for (Loc i = -Ts; i <= Ts; ++i) {
-                for (Loc j = -Ts; j <= Ts; ++j) {
-                    auto loc = blocked.find(Blocked(i, j, 0));
-                    if (loc == blocked.end() || t + 1 < loc->start)
-                        at(i, j, t + 1) = propagate(*this, i, j, t);
-                }
-            }
+            auto bands = layout.bands(t + 1, pool.size());
+            pool.run([&](unsigned w) {
+                    for (Loc i = bands[w]; i < bands[w + 1]; ++i) {
+                        auto const& span = layout.row(i, t + 1);
+                        for (Loc j = span.lo; j <= span.hi; ++j) {
+                            if (!blocked.blocked(i, j, t + 1))
+                                at(i, j, t + 1) = propagate(*this, i, j, t);
+                        }
+                    }
+                });
         }
 
         set_shift(std::move(origin));
     }
 
-    void DP::flip_time() {
+    template<typename C>
+    BasicLayer<C> BasicDP<C>::layer(Time const& t) const {
+        if (t > T)
+            throw std::invalid_argument("t is larger than T");
+        auto tf = flip ? T - t : t;
+        return {layout, tf, table.data() + layout.layer_begin(tf), shift, f};
+    }
+
+    template<typename C>
+    Time BasicDP<C>::max_time() const {
+        return T;
+    }
+
+    template<typename C>
+    std::size_t BasicDP<C>::size() const {
+        return table.size();
+    }
+
+    template<typename C>
+    void BasicDP<C>::flip_time() {
         flip = !flip;
     }
 
-    void DP::flip_coords() {
+    template<typename C>
+    void BasicDP<C>::flip_coords() {
         f *= -1;
     }
 
-    void DP::set_shift(std::pair<Loc, Loc> origin) {
+    template<typename C>
+    void BasicDP<C>::set_shift(std::pair<Loc, Loc> origin) {
         auto [i, j] = origin;
         auto l = std::numeric_limits<Loc>::min() + static_cast<Loc>(T);
         auto u = std::numeric_limits<Loc>::max() - static_cast<Loc>(T);
@@ -116,38 +143,92 @@ namespace dp {
         shift = std::move(origin);
     }
 
-    DP DP::operator*(DP const& other) const {
+    template<typename C>
+    BasicDP<C> BasicDP<C>::operator*(BasicDP const& other) const {
         if (flip == other.flip || T != other.T)
             throw std::invalid_argument("These DPs cannot be combined.");
 
-        DP res(*this);
-        res.blocked.clear();
+        BasicDP res(*this);
+        res.blocked = Obstacles();
+        if (layout.folded()) {
+            res.layout = Layout::diamond(T, layout.diagonal());
+            res.table = std::vector<C>(res.layout.size());
+        }
         auto const* r = this;
-        Loc Ts = static_cast<Loc>(T);
+        auto const& cells = res.layout;
         auto [xs, ys] = shift;
-        for (Time t = 0; t <= T; ++t)
-            for (Loc i = xs - Ts; i <= xs + Ts; ++i)
-                for (Loc j = ys - Ts; j <= ys + Ts; ++j)
+        for (Time t = 0; t <= T; ++t) {
+            auto tf = flip ? T - t : t;
+            for (Loc is = cells.first_row(tf); is <= cells.last_row(tf);
+                    ++is) {
+                auto const& span = cells.row(is, tf);
+                for (Loc js = span.lo; js <= span.hi; ++js) {
+                    Loc i = xs + f * is, j = ys + f * js;
                     res.at(i, j, t) = r->at(i, j, t) * other.at(i, j, t);
+                }
+            }
+        }
         res.blocked = blocked;
         return res;
     }
 
-    std::unordered_map<std::pair<Loc, Loc>, Cnt, LocHash> DP::flatten(Time
-            const& max_time) const {
-        std::unordered_map<std::pair<Loc, Loc>, Cnt, LocHash> res;
+    template<typename C>
+    BasicGrid<C> BasicDP<C>::flatten(Time const& max_time) const {
+        BasicGrid<C> res(static_cast<Loc>(T), shift);
         auto const* r = this;
-        auto [is, js] = shift;
+        auto const cells = layout.folded() ? Layout::diamond(T,
+            layout.diagonal()) : layout;
+        auto [xs, ys] = shift;
         auto tmax = max_time < T ? max_time : T;
-        auto ts = static_cast<Loc>(tmax);
-        for (Loc i = is - ts; i <= is + ts; ++i)
-            for (Loc j = js - ts; j <= js + ts; ++j)
-                for (Time t = 0; t <= tmax; ++t)
-                    if (r->at(i, j, t) > 0)
-                        res[{i, j}] += r->at(i, j, t);
+        for (Time t = 0; t <= tmax; ++t) {
+            auto tf = flip ? T - t : t;
+            for (Loc is = cells.first_row(tf); is <= cells.last_row(tf);
+                    ++is) {
+                auto const& span = cells.row(is, tf);
+                for (Loc js = span.lo; js <= span.hi; ++js) {
+                    Loc i = xs + f * is, j = ys + f * js;
+                    if (r->test_index(i, j, t))
+                        Count<C>::add(res.at(i, j), table[index(i, j, t)]);
+                }
+            }
+        }
         return res;
     }
 
+    template<typename C>
+    void BasicDP<C>::save(std::string const& path) const {
+        if constexpr (std::is_floating_point_v<C>) {
+            throw std::invalid_argument("Only counts can be saved.");
+        } else {
+            TableInfo info;
+            info.shift = shift;
+            info.flip = flip;
+            info.f = f;
+            write_table(path, layout, table.data(), info);
+        }
+    }
+
+// The members that take a stencil, for every compiled stencil.
+#define DP_STENCIL(C, S) \
+    template BasicDP<C>::BasicDP(Time, S, std::pair<Loc, Loc>, \
+        std::unordered_set<Blocked> const&, Storage, unsigned); \
+    template BasicDP<C>::BasicDP(Time, S, Mask const&, std::pair<Loc, Loc>, \
+        unsigned); \
+    template void BasicDP<C>::reblock(S, std::unordered_set<Blocked> const&, \
+        std::unordered_set<Blocked> const&, unsigned);
+#define DP_COUNT(C) \
+    template class BasicDP<C>; \
+    DP_STENCIL(C, Walk4) DP_STENCIL(C, Lazy5) DP_STENCIL(C, King8) \
+    DP_STENCIL(C, Lazy9)
+
+    DP_COUNT(std::uint64_t)
+    DP_COUNT(Wide)
+    DP_COUNT(Cnt)
+    DP_COUNT(double)
+
+#undef DP_COUNT
+#undef DP_STENCIL
+
     Cnt uniform_prop(DP const& r, Loc const& i, Loc const& j, Time const& t) {
         return r.at(i, j, t) + r.at(i - 1, j, t) + r.at(i + 1, j, t)
             + r.at(i, j - 1, t) + r.at(i, j + 1, t);
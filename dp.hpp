@@ -14,62 +14,41 @@
 #define DP_H
 
 #include <functional>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
+#include "counts.hpp"
 #include "defs.hpp"
-
-namespace dp {
-    /**
-     * The description of a blocked cell.
-     */
-    struct Blocked {
-        /// The location of the blocked cell.
-        Loc i, j;
-        /// The step from which the cell is blocked.
-        Time start;
-
-        /**
-         * @brief Initialise a blocked cell.
-         * @param x First dimension.
-         * @param y Second dimension.
-         * @param s Starting from this time, the cell is blocked.
-         */
-        Blocked(Loc x, Loc y, Time s);
-
-        /**
-         * @brief Compare the encoded locations of two instances (time is not
-         * taken into account).
-         * @param o The other instance.
-         * @return `true` iff (i, j) = (o.i, o.j).
-         */
-        bool operator==(Blocked const& o) const;
-    };
-}
-
-// Specialise std::hash to dp::Blocked for use in unordered_set.
-namespace std {
-    template<> struct hash<dp::Blocked> {
-        std::size_t operator()(dp::Blocked const& t) const noexcept {
-            return dp::hash_helper(t.i, t.j);
-        }
-    };
-}
+#include "layout.hpp"
+#include "obstacles.hpp"
+#include "pool.hpp"
+#include "stencil.hpp"
 
 namespace dp {
     /**
      * The dynamic program for computing paths with blocked cells, including
      * access functions and simple operations: shifting, flipping time,
      * combining with another DP.
+     *
+     * The counts are of type C, see `Count` for the supported types; use
+     * `with_count` to pick the narrowest exact one. With C = double, a DP
+     * built from a stencil holds probabilities instead, see `Count<double>`;
+     * products and sums of these are probabilities as well.
      */
-    class DP {
+    template<typename C>
+    class BasicDP {
         /// The maximum number of steps from (0, 0).
         Time const T;
-        /// The dynamic program.
-        std::vector<Cnt> table;
-        /// The set of blocked cells, with times at which they get blocked.
-        std::unordered_set<Blocked> blocked;
+        /// The times at which the cells get blocked.
+        Obstacles blocked;
+        /// Which cells of every layer are stored: those within reach.
+        Layout layout;
+        /// The dynamic program, laid out according to `layout`.
+        std::vector<C> table;
+        /// Whether only the reachable cells are stored, see `stencil_reach`.
+        bool sparse{false};
         /// Whether we have flipped time.
         bool flip{false};
         /// The factor in computing locations, -1 or 1, to flip directions.
@@ -82,13 +61,15 @@ namespace dp {
          * @param i First dimension.
          * @param j Second dimension.
          * @param t Current time.
-         * @return True iff -T <= i, j <= T and 0 <= t <= T, after shift, and
-         * the cell is not blocked at this time.
+         * @return True iff 0 <= t <= T and |i| + |j| <= t, after shift and
+         * time flip, so the cell is stored, and it is not blocked at this
+         * time.
          */
         bool test_index(Loc const& i, Loc const& j, Time const& t) const;
 
         /**
-         * @brief Compute the index within the table, with shift and time flip.
+         * @brief Compute the index within the table, with shift and time flip;
+         * the cell must be stored, see `test_index`.
          * @param i First dimension.
          * @param j Second dimension.
          * @param t Current time.
@@ -96,6 +77,25 @@ namespace dp {
          */
         std::size_t index(Loc const& i, Loc const& j, Time const& t) const;
 
+        /**
+         * @brief Check the blocked cells against the storage mode, and set up
+         * layer 0.
+         */
+        void init();
+
+        /**
+         * @brief Compute layers 1 to T from layer 0 with a stencil.
+         * @param threads The number of threads, see `DP::DP`.
+         */
+        template<typename S>
+        void propagate(unsigned threads);
+
+        /**
+         * @brief The offset of row i within layer t, or the size of the layer
+         * past its last row, to delimit the cells of a run of rows.
+         */
+        std::size_t band_offset(Time const& t, Loc const& i) const;
+
     public:
         /**
          * @brief Compute the number of paths in W_{x, y, t} for all possible
@@ -103,11 +103,57 @@ namespace dp {
          * @param max_time The value of T (allowed number of steps).
          * @param propagate The propagation function, see e.g. uniform_prop.
          * @param blocked_cells The set of blocked cells.
+         * @param storage Which cells to store; `Storage::octant` needs the
+         * blocked cells to be symmetric around the origin, see `symmetric`,
+         * and `propagate` to commute with the symmetries.
+         * @param threads The number of threads that split every layer into
+         * runs of rows, see `Pool`; `propagate` must then be safe to call
+         * concurrently.
          */
-        DP(Time max_time,
-            std::function<Cnt(DP const&, Loc const&, Loc const&, Time const&)>
-            propagate, std::pair<Loc, Loc> origin = {0, 0},
-            std::unordered_set<Blocked> const& blocked_cells = {});
+        BasicDP(Time max_time, std::function<C(BasicDP const&, Loc const&,
+            Loc const&, Time const&)> propagate,
+            std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            Storage storage = Storage::diamond, unsigned threads = 1);
+
+        /**
+         * @brief Compute the number of paths in W_{x, y, t} for all possible
+         * (x, y) and all t <= T, starting in (0, 0), for a compile-time
+         * stencil; this is much faster than passing a propagation function.
+         * @param max_time The value of T (allowed number of steps).
+         * @param stencil The stencil, e.g. `Lazy5{}`.
+         * @param blocked_cells The set of blocked cells.
+         * @param storage Which cells to store, as above; `Storage::reachable`
+         * skips the cells that the obstacles cut off, which pays off on
+         * maze-like maps.
+         * @param threads The number of threads, as above. Every thread only
+         * adds into the cells of its own rows, in the same order as a single
+         * thread would, so the result does not depend on this.
+         * For C = double, every layer is divided by `stencil_weight<S>()`.
+         * The stencils of stencil.hpp are instantiated; `Storage::octant`
+         * needs a symmetric one, see `stencil_symmetric`.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        BasicDP(Time max_time, S stencil, std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            Storage storage = Storage::diamond, unsigned threads = 1);
+
+        /**
+         * @brief Compute the paths from `origin` on a bounded map for a
+         * compile-time stencil, as above. Only the part of the map within
+         * reach is stored, see `Storage::reachable`, so areas beyond the map
+         * or cut off by walls cost nothing.
+         * @param max_time The value of T (allowed number of steps).
+         * @param stencil The stencil, e.g. `Lazy5{}`.
+         * @param map The map, which blocks everything outside of it.
+         * @param origin The starting point of the paths, a cell of the map
+         * that is not blocked from the start; cells keep their coordinates
+         * on the map.
+         * @param threads The number of threads, as above.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        BasicDP(Time max_time, S stencil, Mask const& map,
+            std::pair<Loc, Loc> origin, unsigned threads = 1);
 
         /**
          * @brief Return the value P(i, j, t) in the DP, with 0 for unreachable
@@ -117,17 +163,35 @@ namespace dp {
          * @param t The time, between 0 and T.
          * @return The number of paths in W_{i, j, t}.
          */
-        Cnt at(Loc const& i, Loc const& j, Time const& t) const;
+        C at(Loc const& i, Loc const& j, Time const& t) const;
 
         /**
          * @brief Return the value P(i, j, t) in the DP. Throw an exception for
-         * out-of-bounds values, so not in [-T, T] x [-T, T] x [0, T].
-         * @param i First dimension, -T to T.
-         * @param j Second dimension, -T to T.
+         * cells that are not stored, so not reachable in t steps, or blocked.
+         * @param i First dimension, |i| + |j| <= t.
+         * @param j Second dimension, |i| + |j| <= t.
          * @param t The time, 0 to T.
          * @return The number of paths in W_{i, j, t}.
          */
-        Cnt& at(Loc const& i, Loc const& j, Time const& t);
+        C& at(Loc const& i, Loc const& j, Time const& t);
+
+        /**
+         * @brief A view of the values P(i, j, t) for fixed t, with the same
+         * shift and coordinate flip; valid while the DP exists.
+         * @param t The time, between 0 and T.
+         * @return The layer, accessible with at(i, j).
+         */
+        BasicLayer<C> layer(Time const& t) const;
+
+        /**
+         * @brief The value of T.
+         */
+        Time max_time() const;
+
+        /**
+         * @brief The number of cells stored.
+         */
+        std::size_t size() const;
 
         /**
          * @brief Flip the time, so the paths start at T and end at 0.
@@ -146,23 +210,57 @@ namespace dp {
          */
         void set_shift(std::pair<Loc, Loc> origin);
 
+        /**
+         * @brief Change the blocked cells and update the DP to match, as if it
+         * had been computed with the new cells from the start.
+         *
+         * Changing when a cell c gets blocked, from time s on, only changes
+         * the cells within distance t - s of c in layers t >= s, so only
+         * those rows of these layers are recomputed: an edit of a few cells
+         * costs a fraction of the full DP, as long as s is not small and c
+         * is not far from all other changes. The times are those of the DP
+         * before `flip_time`, and the resulting blocked cells must be
+         * symmetric for `Storage::octant`. With `Storage::reachable` and on
+         * maps, cells can only be blocked, not unblocked.
+         * @param stencil The stencil that the DP was computed with.
+         * @param added Cells to block, in the coordinates of `at`; a cell that
+         * is already blocked earlier stays blocked from then on.
+         * @param removed Cells to unblock at all times, ignoring their start,
+         * applied before `added`.
+         * @param threads The number of threads, see `DP::DP`.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        void reblock(S stencil, std::unordered_set<Blocked> const& added,
+            std::unordered_set<Blocked> const& removed = {},
+            unsigned threads = 1);
+
         /**
          * @brief Combine two DPs by multiplying matching entries.
          * @param other The second DP, with the same `T` and opposite `flip`.
-         * @return The multiplied DP, with the new shift, and no flip.
+         * @return The multiplied DP, with the shift and flip of this one,
+         * stored in full even if the factors were folded.
          */
-        DP operator*(DP const& other) const;
+        BasicDP operator*(BasicDP const& other) const;
 
         /**
          * @brief Flatten a DP to sum up the values at the same time stamp.
          * @param max_time Only sum up from t = 0 to max_time; if max_time >= T,
          * some up over the entire DP.
-         * @return A mapping from points (i, j) to the sum from DP over all t.
+         * @return The sums from DP over all t for the points (i, j) within T
+         * of the shift, accessible with at(i, j); see `to_map` for a mapping.
+         */
+        BasicGrid<C> flatten(Time const& max_time) const;
+
+        /**
+         * @brief Write the DP to a file in the binary format, see
+         * `write_table`, to be read back with `MappedTable`; only for counts.
+         * @param path The name of the file.
          */
-        std::unordered_map<std::pair<Loc, Loc>, Cnt, LocHash> flatten(Time
-            const& max_time) const;
+        void save(std::string const& path) const;
     };
 
+    using DP = BasicDP<Cnt>;
+
     /**
      * @brief Uniform propagation for the DP: one path in each neighbouring
      * direction, one path for staying in the same spot.
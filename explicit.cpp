@@ -45,28 +45,28 @@ namespace {
 
 namespace xpl {
     Table compute_paths(Time const& T, std::pair<Loc, Loc> const& shift) {
-        std::unordered_map<std::pair<Loc, Loc>, Cnt, dp::LocHash> table;
-        auto max_cnt = max_num(T);
         auto [is, js] = shift;
+        Table table(static_cast<Loc>(T), shift);
+        auto max_cnt = max_num(T);
         PList visited;
         for (Cnt cntr = 0; cntr <= max_cnt; ++cntr) {
             auto [i, j] = decode(cntr, visited);
-            table[{i + is, j + js}]++;
+            table.at(i + is, j + js)++;
         }
         return table;
     }
 
     Table visits(Time const& T, std::pair<Loc, Loc> const& shift,
             std::pair<Loc, Loc> const& end) {
-        Table table;
-        auto max_cnt = max_num(T);
         auto [is, js] = shift;
+        Table table(static_cast<Loc>(T), shift);
+        auto max_cnt = max_num(T);
         PList visited;
         for (Cnt cntr = 0; cntr <= max_cnt; ++cntr) {
             auto [i, j] = decode(cntr, visited);
             if (end.first == is + i && end.second == js + j)
                 for (auto const& [x, y]: visited)
-                    table[{is + x, js + y}]++;
+                    table.at(is + x, js + y)++;
         }
         return table;
     }
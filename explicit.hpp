@@ -18,10 +18,11 @@
 #include <utility>
 #include <vector>
 #include "defs.hpp"
+#include "layout.hpp"
 
 namespace xpl {
     using ::dp::Cnt, ::dp::Loc, ::dp::Time, ::dp::LocHash;
-    using Table = std::unordered_map<std::pair<Loc, Loc>, Cnt, LocHash>;
+    using Table = ::dp::Grid;
     using PList = std::unordered_set<std::pair<Loc, Loc>, LocHash>;
 
     /**
@@ -32,8 +33,8 @@ namespace xpl {
      * Note: this runs in O(5^T) time, use the DP instead.
      * @param T The maximum number of steps / time limit.
      * @param shift The origin, from which we start the paths.
-     * @return An instance of `Table` with the counts, each associated with a
-     * location (x, y).
+     * @return An instance of `Table` with the counts within T of shift,
+     * accessible with at(x, y).
      */
     Table compute_paths(Time const& T, std::pair<Loc, Loc> const& shift);
 
@@ -45,8 +46,8 @@ namespace xpl {
      * @param T The maximum number of steps / time limit.
      * @param shift The origin, from which we start the paths.
      * @param end The path destination.
-     * @return An instance of `Table` with the counts, each associated with a
-     * location (x, y).
+     * @return An instance of `Table` with the counts within T of shift,
+     * accessible with at(x, y).
      */
     Table visits(Time const& T, std::pair<Loc, Loc> const& shift,
         std::pair<Loc, Loc> const& end);
@@ -0,0 +1,286 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "layout.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace dp {
+    Layout::Layout(Time max_time,
+            std::function<std::pair<Loc, Loc>(Time const&)> const& row_range,
+            std::function<std::pair<Loc, Loc>(Loc const&, Time const&)> const&
+            col_range): T{std::move(max_time)} {
+        if (T > std::numeric_limits<Loc>::max())
+            throw std::length_error("Please pick a lower value of T.");
+
+        first.reserve(T + 1);
+        rows.reserve(T + 2);
+        begin.reserve(T + 2);
+        std::size_t pos = 0;
+        for (Time t = 0; t <= T; ++t) {
+            auto [ilo, ihi] = row_range(t);
+            first.push_back(ilo);
+            rows.push_back(spans.size());
+            begin.push_back(pos);
+            std::size_t offset = 0;
+            for (Loc i = ilo; i <= ihi; ++i) {
+                auto [lo, hi] = col_range(i, t);
+                spans.push_back({lo, hi, offset});
+                if (lo <= hi)
+                    offset += static_cast<std::size_t>(hi - lo) + 1;
+            }
+            pos += offset;
+        }
+        rows.push_back(spans.size());
+        begin.push_back(pos);
+    }
+
+    Layout Layout::diamond(Time max_time, bool diagonal) {
+        Layout res(std::move(max_time), [](Time const& t) {
+                auto r = static_cast<Loc>(t);
+                return std::make_pair(-r, r);
+            }, [=](Loc const& i, Time const& t) {
+                auto r = static_cast<Loc>(t) - (diagonal ? 0 : std::abs(i));
+                return std::make_pair(-r, r);
+            });
+        res.diag = diagonal;
+        return res;
+    }
+
+    Layout Layout::octant(Time max_time, bool diagonal) {
+        Layout res(std::move(max_time), [](Time const& t) {
+                return std::make_pair(0, static_cast<Loc>(t));
+            }, [=](Loc const& i, Time const& t) {
+                auto r = static_cast<Loc>(t) - (diagonal ? 0 : i);
+                return std::make_pair(0, i < r ? i : r);
+            });
+        res.fold = true;
+        res.diag = diagonal;
+        return res;
+    }
+
+    Layout Layout::box(Time max_time, std::array<Loc, 4> const& bounds,
+            bool diagonal) {
+        auto [i0, i1, j0, j1] = bounds;
+        if (i0 > 0 || i1 < 0 || j0 > 0 || j1 < 0)
+            throw std::invalid_argument("The box does not contain (0, 0).");
+        Layout res(std::move(max_time), [=](Time const& t) {
+                auto r = static_cast<Loc>(t);
+                return std::make_pair(std::max(-r, i0), std::min(r, i1));
+            }, [=](Loc const& i, Time const& t) {
+                auto r = static_cast<Loc>(t) - (diagonal ? 0 : std::abs(i));
+                return std::make_pair(std::max(-r, j0), std::min(r, j1));
+            });
+        res.diag = diagonal;
+        return res;
+    }
+
+    Layout Layout::make(Storage storage, Time max_time, bool diagonal) {
+        switch (storage) {
+            case Storage::octant: return octant(std::move(max_time), diagonal);
+            case Storage::diamond: return diamond(std::move(max_time),
+                diagonal);
+            case Storage::reachable: throw std::invalid_argument("This "
+                "storage mode needs a stencil and the obstacles.");
+            default: throw std::invalid_argument("Unknown storage mode.");
+        }
+    }
+
+    bool Layout::folded() const {
+        return fold;
+    }
+
+    bool Layout::diagonal() const {
+        return diag;
+    }
+
+    Time Layout::max_time() const {
+        return T;
+    }
+
+    std::size_t Layout::size() const {
+        return begin.back();
+    }
+
+    std::size_t Layout::layer_begin(Time const& t) const {
+        assert(t <= T + 1);
+        return begin[t];
+    }
+
+    std::size_t Layout::layer_size(Time const& t) const {
+        assert(t <= T);
+        return begin[t + 1] - begin[t];
+    }
+
+    Loc Layout::first_row(Time const& t) const {
+        assert(t <= T);
+        return first[t];
+    }
+
+    Loc Layout::last_row(Time const& t) const {
+        assert(t <= T);
+        return first[t] + static_cast<Loc>(rows[t + 1] - rows[t]) - 1;
+    }
+
+    Span const& Layout::row(Loc const& i, Time const& t) const {
+        assert(i >= first_row(t) && i <= last_row(t));
+        return spans[rows[t] + static_cast<std::size_t>(i - first[t])];
+    }
+
+    std::vector<Loc> Layout::bands(Time const& t, unsigned count) const {
+        assert(count > 0);
+        std::vector<Loc> res{first_row(t)};
+        auto i = first_row(t);
+        for (unsigned k = 1; k < count; ++k) {
+            auto target = layer_size(t) * k / count;
+            while (i <= last_row(t) && row(i, t).offset < target)
+                ++i;
+            res.push_back(i);
+        }
+        res.push_back(last_row(t) + 1);
+        return res;
+    }
+
+    std::size_t Layout::offset(Loc const& i, Loc const& j,
+            Time const& t) const {
+        auto a = i, b = j;
+        if (fold) {
+            a = std::abs(a);
+            b = std::abs(b);
+            if (b > a)
+                std::swap(a, b);
+        }
+        if (t > T || a < first_row(t) || a > last_row(t))
+            return npos;
+        auto const& s = row(a, t);
+        if (b < s.lo || b > s.hi)
+            return npos;
+        return s.offset + static_cast<std::size_t>(b - s.lo);
+    }
+
+    template<typename C>
+    BasicLayer<C>::BasicLayer(Layout const& l, Time time, C const* first,
+            std::pair<Loc, Loc> origin, Loc factor): layout{&l},
+            t{std::move(time)}, cells{first}, shift{std::move(origin)},
+            f{std::move(factor)} {
+        // Intentionally left blank.
+    }
+
+    template<typename C>
+    Time BasicLayer<C>::time() const {
+        return t;
+    }
+
+    template<typename C>
+    C BasicLayer<C>::at(Loc const& i, Loc const& j) const {
+        auto [si, sj] = shift;
+        auto offset = layout->offset(f * (i - si), f * (j - sj), t);
+        return offset == Layout::npos ? C{0} : cells[offset];
+    }
+
+    template class BasicLayer<std::uint64_t>;
+    template class BasicLayer<Wide>;
+    template class BasicLayer<Cnt>;
+    template class BasicLayer<double>;
+
+    template<typename C>
+    BasicGrid<C>::BasicGrid(Loc radius, std::pair<Loc, Loc> origin):
+            r{std::move(radius)}, centre{std::move(origin)},
+            cells(static_cast<std::size_t>(2 * r + 1)
+            * static_cast<std::size_t>(2 * r + 1)) {
+        // Intentionally left blank.
+    }
+
+    template<typename C>
+    std::size_t BasicGrid<C>::index(Loc const& i, Loc const& j) const {
+        auto [a, b] = centre;
+        if (i < a - r || i > a + r || j < b - r || j > b + r)
+            return Layout::npos;
+        return static_cast<std::size_t>(i - a + r)
+            * static_cast<std::size_t>(2 * r + 1)
+            + static_cast<std::size_t>(j - b + r);
+    }
+
+    template<typename C>
+    C BasicGrid<C>::at(Loc const& i, Loc const& j) const {
+        auto k = index(i, j);
+        return k == Layout::npos ? C{0} : cells[k];
+    }
+
+    template<typename C>
+    C& BasicGrid<C>::at(Loc const& i, Loc const& j) {
+        auto k = index(i, j);
+        if (k == Layout::npos)
+            throw std::out_of_range("Cell outside of the grid.");
+        return cells[k];
+    }
+
+    template<typename C>
+    Loc BasicGrid<C>::radius() const {
+        return r;
+    }
+
+    template<typename C>
+    std::pair<Loc, Loc> BasicGrid<C>::origin() const {
+        return centre;
+    }
+
+    template<typename C>
+    C const* BasicGrid<C>::data() const {
+        return cells.data();
+    }
+
+    template<typename C>
+    bool BasicGrid<C>::operator==(BasicGrid const& o) const {
+        if (r == o.r && centre == o.centre)
+            return cells == o.cells;
+        auto [a, b] = centre;
+        auto [c, d] = o.centre;
+        for (Loc i = std::min(a - r, c - o.r); i <= std::max(a + r, c + o.r);
+                ++i)
+            for (Loc j = std::min(b - r, d - o.r);
+                    j <= std::max(b + r, d + o.r); ++j)
+                if (at(i, j) != o.at(i, j))
+                    return false;
+        return true;
+    }
+
+    template<typename C>
+    std::unordered_map<std::pair<Loc, Loc>, C, LocHash> to_map(
+            BasicGrid<C> const& grid) {
+        std::unordered_map<std::pair<Loc, Loc>, C, LocHash> res;
+        auto [a, b] = grid.origin();
+        auto r = grid.radius();
+        for (Loc i = a - r; i <= a + r; ++i)
+            for (Loc j = b - r; j <= b + r; ++j)
+                if (grid.at(i, j) != 0)
+                    res.emplace(std::make_pair(i, j), grid.at(i, j));
+        return res;
+    }
+
+    template class BasicGrid<std::uint64_t>;
+    template class BasicGrid<Wide>;
+    template class BasicGrid<Cnt>;
+    template class BasicGrid<double>;
+
+    template std::unordered_map<std::pair<Loc, Loc>, std::uint64_t, LocHash>
+        to_map(BasicGrid<std::uint64_t> const&);
+    template std::unordered_map<std::pair<Loc, Loc>, Wide, LocHash> to_map(
+        BasicGrid<Wide> const&);
+    template std::unordered_map<std::pair<Loc, Loc>, Cnt, LocHash> to_map(
+        BasicGrid<Cnt> const&);
+    template std::unordered_map<std::pair<Loc, Loc>, double, LocHash> to_map(
+        BasicGrid<double> const&);
+}
@@ -0,0 +1,325 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+
+namespace dp {
+    /**
+     * Which part of the reachable cells a table stores.
+     */
+    enum class Storage {
+        /// All reachable cells, see `Layout::diamond`.
+        diamond,
+        /// One of the eight symmetric copies, see `Layout::octant`.
+        octant,
+        /// Only the cells that the walk can reach past the obstacles, see
+        /// `stencil_reach`; only for a `DP` built from a stencil.
+        reachable
+    };
+
+    /**
+     * A run of consecutive stored cells (i, lo), ..., (i, hi) in one row of a
+     * layer; the row is empty if lo > hi.
+     */
+    struct Span {
+        /// The first and the last stored column.
+        Loc lo, hi;
+        /// The position of (i, lo) relative to the start of the layer.
+        std::size_t offset;
+    };
+
+    /**
+     * The storage layout of a table with layers 0 <= t <= T: which cells of
+     * every layer are stored, and where. Every layer is a contiguous block of
+     * rows, every row a contiguous block of cells. Cells outside of the layout
+     * are not stored and are treated as zero.
+     */
+    class Layout {
+        /// The last layer.
+        Time T{0};
+        /// The first row of each layer.
+        std::vector<Loc> first;
+        /// Per layer, the index of its first row in `spans`; T + 2 entries.
+        std::vector<std::size_t> rows;
+        /// The rows of all layers, in order.
+        std::vector<Span> spans;
+        /// Per layer, the position of its first cell; T + 2 entries.
+        std::vector<std::size_t> begin;
+        /// Whether coordinates are folded into the octant 0 <= j <= i.
+        bool fold{false};
+        /// Whether layer t spans max(|i|, |j|) <= t instead of |i| + |j| <= t.
+        bool diag{false};
+
+    public:
+        /// Returned by `offset` for cells that are not stored.
+        static constexpr std::size_t npos =
+            std::numeric_limits<std::size_t>::max();
+
+        /**
+         * @brief Build a layout from a description of the rows and columns.
+         * @param max_time The last layer T.
+         * @param row_range For a layer t, the first and the last row stored.
+         * @param col_range For a row i in layer t, the first and the last
+         * column stored.
+         */
+        Layout(Time max_time,
+            std::function<std::pair<Loc, Loc>(Time const&)> const& row_range,
+            std::function<std::pair<Loc, Loc>(Loc const&, Time const&)> const&
+            col_range);
+
+        /**
+         * @brief The layout that stores, in layer t, exactly the cells
+         * (i, j) with |i| + |j| <= t, i.e. those reachable from (0, 0).
+         * @param max_time The last layer T.
+         * @param diagonal Whether the walk also moves diagonally, so that
+         * layer t is the square of cells with max(|i|, |j|) <= t instead.
+         * @return The layout.
+         */
+        static Layout diamond(Time max_time, bool diagonal = false);
+
+        /**
+         * @brief The layout that stores, in layer t, the cells (i, j) with
+         * 0 <= j <= i and i + j <= t. Any other cell is folded into this
+         * octant by sign flips and swapping i and j, so it only suits tables
+         * that are symmetric under these operations.
+         * @param max_time The last layer T.
+         * @param diagonal As for `diamond`, with j <= i <= t instead.
+         * @return The layout.
+         */
+        static Layout octant(Time max_time, bool diagonal = false);
+
+        /**
+         * @brief The layout that stores, in layer t, the cells (i, j) with
+         * |i| + |j| <= t within a box, e.g. around a bounded map; cells
+         * outside of the box are not stored, so they stay zero.
+         * @param max_time The last layer T.
+         * @param bounds The first and last row, the first and last column of
+         * the box, which must contain (0, 0).
+         * @param diagonal As for `diamond`.
+         * @return The layout.
+         */
+        static Layout box(Time max_time, std::array<Loc, 4> const& bounds,
+            bool diagonal = false);
+
+        /**
+         * @brief The layout for the given storage mode, other than
+         * `Storage::reachable`, which depends on the obstacles.
+         * @param storage The storage mode.
+         * @param max_time The last layer T.
+         * @param diagonal As for `diamond`.
+         * @return The layout.
+         */
+        static Layout make(Storage storage, Time max_time,
+            bool diagonal = false);
+
+        /**
+         * @brief Whether cells are folded into a symmetric part, see `octant`.
+         */
+        bool folded() const;
+
+        /**
+         * @brief Whether the layers are squares, see `diamond`.
+         */
+        bool diagonal() const;
+
+        /**
+         * @brief The last layer T.
+         */
+        Time max_time() const;
+
+        /**
+         * @brief The total number of stored cells.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief The position of the first cell of layer t in the table.
+         * @param t The layer, 0 to T + 1 (the latter for the end).
+         */
+        std::size_t layer_begin(Time const& t) const;
+
+        /**
+         * @brief The number of cells stored in layer t.
+         */
+        std::size_t layer_size(Time const& t) const;
+
+        /**
+         * @brief The first row stored in layer t.
+         */
+        Loc first_row(Time const& t) const;
+
+        /**
+         * @brief The last row stored in layer t.
+         */
+        Loc last_row(Time const& t) const;
+
+        /**
+         * @brief The stored run of row i in layer t; i must be between
+         * `first_row(t)` and `last_row(t)`.
+         */
+        Span const& row(Loc const& i, Time const& t) const;
+
+        /**
+         * @brief Split the rows of layer t into runs with about the same
+         * number of cells each, e.g. to propagate them on several threads.
+         * @param t The layer, 0 to T.
+         * @param count The number of runs, positive.
+         * @return `count + 1` rows; run k is from row k up to, but not
+         * including, row k + 1. Some runs may be empty.
+         */
+        std::vector<Loc> bands(Time const& t, unsigned count) const;
+
+        /**
+         * @brief Find a cell within its layer, folding it first if needed.
+         * @param i First dimension.
+         * @param j Second dimension.
+         * @param t The layer, 0 to T.
+         * @return The position of (i, j) relative to `layer_begin(t)`, or
+         * `npos` if the cell is not stored.
+         */
+        std::size_t offset(Loc const& i, Loc const& j, Time const& t) const;
+    };
+
+    /**
+     * A read-only view of one layer of a table stored in a `Layout`, with the
+     * same shift and coordinate flip as in `DP`. The view does not own the
+     * cells and is invalidated with the storage.
+     */
+    template<typename C>
+    class BasicLayer {
+        /// The layout of the table.
+        Layout const* layout;
+        /// The layer within the layout.
+        Time t;
+        /// The first cell of the layer.
+        C const* cells;
+        /// The shift, i.e. starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift;
+        /// The factor in computing locations, -1 or 1, to flip directions.
+        Loc f;
+
+    public:
+        /**
+         * @brief Initialise a view of a layer.
+         * @param l The layout of the table.
+         * @param time The layer within the layout.
+         * @param first The first cell of the layer.
+         * @param origin The shift, i.e. starting position instead of (0, 0).
+         * @param factor -1 to flip the coordinates, 1 otherwise.
+         */
+        BasicLayer(Layout const& l, Time time, C const* first,
+            std::pair<Loc, Loc> origin = {0, 0}, Loc factor = 1);
+
+        /**
+         * @brief The time of the layer within its layout.
+         */
+        Time time() const;
+
+        /**
+         * @brief Return the value at (i, j) in this layer, with 0 for cells
+         * that are not stored.
+         * @param i First dimension.
+         * @param j Second dimension.
+         * @return The value at (i, j), after shift and flip.
+         */
+        C at(Loc const& i, Loc const& j) const;
+    };
+
+    using Layer = BasicLayer<Cnt>;
+
+    /**
+     * A dense square of values for the cells (i, j) with |i - a| <= r and
+     * |j - b| <= r around a centre (a, b), e.g. the visit counts of all the
+     * cells within reach of (a, b) in r steps.
+     */
+    template<typename C>
+    class BasicGrid {
+        /// The distance from the centre to the sides.
+        Loc r;
+        /// The centre.
+        std::pair<Loc, Loc> centre;
+        /// The values, row by row.
+        std::vector<C> cells;
+
+        /**
+         * @brief The position of (i, j) in `cells`, or `Layout::npos` if the
+         * cell is outside of the square.
+         */
+        std::size_t index(Loc const& i, Loc const& j) const;
+
+    public:
+        /**
+         * @brief Initialise a grid with all values 0.
+         * @param radius The distance from the centre to the sides.
+         * @param origin The centre.
+         */
+        BasicGrid(Loc radius, std::pair<Loc, Loc> origin = {0, 0});
+
+        /**
+         * @brief Return the value at (i, j), with 0 outside of the square.
+         */
+        C at(Loc const& i, Loc const& j) const;
+
+        /**
+         * @brief Return the value at (i, j). Throw an exception outside of the
+         * square.
+         */
+        C& at(Loc const& i, Loc const& j);
+
+        /**
+         * @brief The distance from the centre to the sides.
+         */
+        Loc radius() const;
+
+        /**
+         * @brief The centre.
+         */
+        std::pair<Loc, Loc> origin() const;
+
+        /**
+         * @brief The values, row by row from (a - r, b - r) to (a + r, b + r).
+         */
+        C const* data() const;
+
+        /**
+         * @brief Compare the values of two grids, with 0 outside of either
+         * square, so the sizes may differ.
+         * @param o The other grid.
+         * @return `true` iff at(i, j) = o.at(i, j) for all (i, j).
+         */
+        bool operator==(BasicGrid const& o) const;
+    };
+
+    using Grid = BasicGrid<Cnt>;
+
+    /**
+     * @brief Convert a grid to a map with the non-zero values, for code that
+     * uses the map-based results.
+     * @param grid The grid.
+     * @return A mapping from points (i, j) to the non-zero values at (i, j).
+     */
+    template<typename C>
+    std::unordered_map<std::pair<Loc, Loc>, C, LocHash> to_map(
+        BasicGrid<C> const& grid);
+}
+#endif
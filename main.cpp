@@ -14,9 +14,11 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <random>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include "cache.hpp"
 #include "dp.hpp"
 #include "problems.hpp"
 #include "explicit.hpp"
@@ -40,31 +42,48 @@ namespace {
     }
 
     /**
-     * @brief Output the last layer of the DP to a stream.
-     * @param table The DP.
-     * @param T The T of the DP; we output the layer at time T.
+     * @brief Output a layer of the DP to a stream.
+     * @param layer The layer of the DP.
+     * @param T The time of the layer, which bounds the output range.
      * @param shift The start point of the DP.
      * @param outf The output stream.
      */
-    void dp_write(dp::DP const& table, dp::Time const& T,
+    template<typename C>
+    void dp_write(dp::BasicLayer<C> const& layer, dp::Time const& T,
             std::pair<dp::Loc, dp::Loc> const& shift, std::ostream& outf) {
         auto [is, js] = shift;
         auto sT = static_cast<dp::Loc>(T);
         outf << T << '\n';
         for (dp::Loc i = is - sT; i <= is + sT; ++i)
             for (dp::Loc j = js - sT; j <= js + sT; ++j)
-                outf << table.at(i, j, T) << (j < js + sT ? ' ' : '\n');
+                outf << dp::to_cnt(layer.at(i, j))
+                    << (j < js + sT ? ' ' : '\n');
         outf.flush();
     }
 
+    /**
+     * @brief Output the last layer of the paths from (0, 0) with obstacles to
+     * a file.
+     * @param paths The DP of the paths.
+     * @param T The time of the layer.
+     * @param fname The name of the output file.
+     */
+    template<typename C>
+    void obstacles_write(dp::BasicDP<C> const& paths, dp::Time const& T,
+            std::string const& fname) {
+        std::ofstream outf(fname);
+        dp_write(paths.layer(T), T, {0, 0}, outf);
+    }
+
     /**
      * @brief Output the flattened DP to a stream.
-     * @param table The DP.
+     * @param table The DP, `DP` or `RnsDP`.
      * @param T The T of the DP; we output the layer at time T.
      * @param shift The start point of the DP.
      * @param outf The output stream.
      */
-    void flat_write(dp::DP const& table, dp::Time const& T,
+    template<typename Table>
+    void flat_write(Table const& table, dp::Time const& T,
             std::pair<dp::Loc, dp::Loc> const& shift, std::ostream& outf) {
         auto fl_table = table.flatten(T);
         auto [is, js] = shift;
@@ -72,12 +91,12 @@ namespace {
         outf << T << '\n';
         for (dp::Loc i = is - sT; i <= is + sT; ++i)
             for (dp::Loc j = js - sT; j <= js + sT; ++j)
-                outf << fl_table[{i, j}] << (j < js + sT ? ' ' : '\n');
+                outf << fl_table.at(i, j) << (j < js + sT ? ' ' : '\n');
     }
 
     /**
-     * @brief Output a trajectory to a stream.
-     * @param traj The trajectory.
+     * @brief Output one or more trajectories to a stream, a point per line.
+     * @param traj The trajectories, one after another.
      * @param outf The output stream.
      */
     void traj_write(std::vector<std::pair<dp::Loc, dp::Loc>> const& traj,
@@ -91,20 +110,19 @@ namespace {
      * explicit computation.
      * @param T The T of the explicit computation, not larger than T of DP.
      * @param a The DP.
-     * @param b The explicit table.
+     * @param b The explicit table, or a `Grid` with layer T.
      * @param shift The start point of both `a` and `b`.
      * @return "correct" if the counts match, "mismatch" otherwise.
      */
+    template<typename Table>
     std::string check_paths(dp::Time const& T, dp::DP const& a,
-            xpl::Table const& b, std::pair<dp::Loc, dp::Loc> const& shift) {
+            Table const& b, std::pair<dp::Loc, dp::Loc> const& shift) {
         auto [is, js] = shift;
         auto sT = static_cast<dp::Loc>(T);
         bool correct = true;
         for (dp::Loc i = is - sT; i <= is + sT; ++i) {
             for (dp::Loc j = js - sT; j <= js + sT; ++j) {
-                auto b_it = b.find({i, j});
-                auto b_val = (b_it != b.end() ? b_it->second : 0);
-                correct &= (a.at(i, j, T) == b_val);
+                correct &= (a.at(i, j, T) == b.at(i, j));
             }
         }
         return correct ? "correct" : "mismatch";
@@ -114,11 +132,12 @@ namespace {
      * @brief Check if the visit counts match up for the DP and the explicit
      * computation.
      * @param T The T of both the explicit computation and the DP.
-     * @param a The DP.
+     * @param a The DP, `DP` or `RnsDP`.
      * @param b The explicit table.
      * @return "correct" if the counts match, "mismatch" otherwise.
      */
-    std::string check_visits(dp::Time const& T, dp::DP const& a,
+    template<typename Table>
+    std::string check_visits(dp::Time const& T, Table const& a,
             xpl::Table const& b) {
         auto af = a.flatten(T);
         return (af == b ? "correct" : "mismatch");
@@ -148,18 +167,27 @@ int main() {
     } while (true);
 
     std::cout << "Computing the DP for all paths... " << std::flush;
-    auto [r1, t1] = time_and_save(prob::all_paths, 10u,
-        std::make_pair<>(0_loc, 0_loc), std::initializer_list<dp::Blocked>{});
+    auto [r1, t1] = time_and_save(prob::all_paths<dp::Cnt>, 10u,
+        std::make_pair<>(0_loc, 0_loc), std::initializer_list<dp::Blocked>{},
+        dp::Storage::octant, 1u);
     std::cout << "done." << std::endl;
     std::ofstream out1("data/paths_dp");
-    dp_write(r1, 10u, {0, 0}, out1);
+    dp_write(r1.layer(10u), 10u, {0, 0}, out1);
+    std::cout << "Checking the direct computation of its last layer... "
+        << check_paths(10u, r1, dp::rns_layer(10u), {0_loc, 0_loc}) << '\n';
 
     std::cout << "Computing the DP for visits... " << std::flush;
-    auto [r2, t2] = time_and_save(prob::visit_all, T1,
-        std::make_pair<>(0_loc, 0_loc), std::make_pair<>(40_loc, 20_loc));
-    std::cout << "done.\n" << std::endl;
+    auto [r2, t2] = time_and_save(prob::visit_all<dp::Cnt>, T1,
+        std::make_pair<>(0_loc, 0_loc), std::make_pair<>(40_loc, 20_loc), 1u);
+    std::cout << "done." << std::endl;
     std::ofstream out2("data/visits_dp");
     flat_write(r2, T1, {0, 0}, out2);
+    std::cout << "Computing the same DP modulo primes... " << std::flush;
+    auto [r5, t5] = time_and_save(prob::visit_all_rns, T1,
+        std::make_pair<>(0_loc, 0_loc), std::make_pair<>(40_loc, 20_loc));
+    std::cout << "done.\nChecking it against the DP... "
+        << (r5.flatten(T1) == r2.flatten(T1) ? "correct" : "mismatch")
+        << "\n" << std::endl;
 
     do {
         std::cout << "Please input the time limit T for the explicit "
@@ -195,12 +223,16 @@ int main() {
         std::cout << check_visits(T2, r2, r4) << "\n\n";
     }
 
-    std::cout << "Times (ms):\n" << "Problem       DP Explicit\nPaths   "
+    std::cout << "Times (ms), RNS for the visits modulo primes:\n"
+        << "Problem       DP Explicit\nPaths   "
         << std::setw(8) << std::chrono::duration_cast<ms>(t1).count() << ' '
         << std::setw(8) << std::chrono::duration_cast<ms>(t3).count()
         << "\nVisits  "
         << std::setw(8) << std::chrono::duration_cast<ms>(t2).count() << ' '
-        << std::setw(8) << std::chrono::duration_cast<ms>(t4).count() << "\n\n";
+        << std::setw(8) << std::chrono::duration_cast<ms>(t4).count()
+        << "\nRNS     "
+        << std::setw(8) << std::chrono::duration_cast<ms>(t5).count() << ' '
+        << std::setw(8) << '-' << "\n\n";
 
     std::cout << "Part 2: obstacles\nWe run the DP with obstacles to provide "
         << "intuition about the propagation\nbehaviour in the presence of "
@@ -225,30 +257,28 @@ int main() {
         }
     } while (true);
 
-    std::unordered_set<dp::Blocked> wall;
-    for (dp::Loc i = -10; i <= 10; ++i)
-        wall.emplace(i, 3, 0);
-    auto o1 = prob::all_paths(10, {0, 0}, wall);
-    std::ofstream wall1("data/wall");
-    dp_write(o1, 10, {0, 0}, wall1);
-
-    for (dp::Loc i = 1; i <= 3; ++i)
-        wall.erase({i, 3, 0});
-    auto o2 = prob::all_paths(10, {0, 0}, wall);
-    std::ofstream wall2("data/wall_gap");
-    dp_write(o2, 10, {0, 0}, wall2);
-
-    wall.clear();
-    for (dp::Loc i = -1; i <= 2; ++i)
+    // The examples differ by a few cells, so one DP is updated in between.
+    std::unordered_set<dp::Blocked> wall, gap, ends, small, middle;
+    for (dp::Loc i = -10; i <= 10; ++i) {
         wall.emplace(i, 3, 0);
-    auto o3 = prob::all_paths(10, {0, 0}, wall);
-    std::ofstream wall3("data/sm_wall");
-    dp_write(o3, 10, {0, 0}, wall3);
-
-    wall.erase({0, 3, 0});
-    auto o4 = prob::all_paths(10, {0, 0}, wall);
-    std::ofstream wall4("data/sm_wall_gap");
-    dp_write(o4, 10, {0, 0}, wall4);
+        if (i >= 1 && i <= 3)
+            gap.emplace(i, 3, 0);
+        else if (i <= -2 || i >= 4)
+            ends.emplace(i, 3, 0);
+    }
+    small = {{1, 3, 0}, {2, 3, 0}};
+    middle.emplace(0, 3, 0);
+    dp::with_count(dp::path_bound(10), [&](auto tag) {
+            using C = typename decltype(tag)::type;
+            auto paths = prob::all_paths<C>(10, {0, 0}, wall);
+            obstacles_write(paths, 10, "data/wall");
+            paths.reblock(dp::Lazy5{}, {}, gap);
+            obstacles_write(paths, 10, "data/wall_gap");
+            paths.reblock(dp::Lazy5{}, small, ends);
+            obstacles_write(paths, 10, "data/sm_wall");
+            paths.reblock(dp::Lazy5{}, {}, middle);
+            obstacles_write(paths, 10, "data/sm_wall_gap");
+        });
 
     if (own) {
         wall.clear();
@@ -293,14 +323,22 @@ int main() {
                 break;
         } while (true);
 
-        auto paths = prob::all_paths(T3, {si, sj});
-        for (dp::Cnt c = 0; c < pc; ++c) {
-            auto ti = prob::generate_path(T3, paths, {ei, ej});
-            std::string fname("data/traj");
-            fname += c.get_str();
-            std::ofstream out3(fname);
-            traj_write(ti, out3);
+        if (prob::count_paths(T3, {si, sj}, {ei, ej}) == 0) {
+            std::cout << "The end point cannot be reached in " << T3
+                << " steps.\n";
+            return 0;
         }
+        dp::with_count(dp::path_bound(T3), [&](auto tag) {
+                using C = typename decltype(tag)::type;
+                auto paths = dp::BasicCache<C>::global().paths(T3, {si, sj},
+                    {}, 0);
+                std::random_device rd;
+                auto ti = prob::generate_paths(T3, paths, {ei, ej},
+                    pc.get_ui(), rd(), 0);
+                std::ofstream out3("data/trajs");
+                out3 << ti.size() / (T3 + 1) << ' ' << T3 << '\n';
+                traj_write(ti, out3);
+            });
     }
     return 0;
 }
@@ -0,0 +1,125 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "mask.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    /**
+     * @brief Read the next number of a PGM header, skipping white space and
+     * comments.
+     */
+    unsigned long pgm_number(std::istream& in) {
+        int c;
+        while ((c = in.peek()) != EOF && (std::isspace(c) || c == '#')) {
+            if (c == '#')
+                in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            else
+                in.get();
+        }
+        unsigned long res;
+        if (!(in >> res))
+            throw std::runtime_error("Malformed PGM file.");
+        return res;
+    }
+}
+
+namespace dp {
+    Mask::Mask(Loc height, Loc width): rows{height}, cols{width} {
+        if (rows < 0 || cols < 0)
+            throw std::invalid_argument("The map cannot have a negative "
+                "size.");
+        since.assign(static_cast<std::size_t>(rows)
+            * static_cast<std::size_t>(cols), never);
+    }
+
+    Mask Mask::read_pgm(std::string const& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error("Cannot open " + path + ".");
+        char magic[2];
+        if (!in.read(magic, 2) || magic[0] != 'P' || (magic[1] != '2'
+                && magic[1] != '5'))
+            throw std::runtime_error("Not a PGM file: " + path + ".");
+        auto width = pgm_number(in), height = pgm_number(in);
+        auto maxval = pgm_number(in);
+        if (maxval == 0 || maxval > 65535
+                || width > static_cast<unsigned long>(
+                std::numeric_limits<Loc>::max())
+                || height > static_cast<unsigned long>(
+                std::numeric_limits<Loc>::max()))
+            throw std::runtime_error("Malformed PGM file.");
+        // A single white space character separates the header from binary
+        // pixels.
+        in.get();
+
+        Mask res(static_cast<Loc>(height), static_cast<Loc>(width));
+        for (auto& s: res.since) {
+            unsigned long v;
+            if (magic[1] == '2') {
+                v = pgm_number(in);
+            } else {
+                unsigned char bytes[2] = {0, 0};
+                auto n = maxval < 256 ? 1 : 2;
+                if (!in.read(reinterpret_cast<char*>(bytes), n))
+                    throw std::runtime_error("Truncated PGM file.");
+                v = n == 1 ? bytes[0] : bytes[0] * 256ul + bytes[1];
+            }
+            if (v > maxval)
+                throw std::runtime_error("Malformed PGM file.");
+            s = v == maxval ? never : static_cast<Time>(v);
+        }
+        return res;
+    }
+
+    Loc Mask::height() const {
+        return rows;
+    }
+
+    Loc Mask::width() const {
+        return cols;
+    }
+
+    Time Mask::from(Loc const& i, Loc const& j) const {
+        if (i < 0 || i >= rows || j < 0 || j >= cols)
+            return 0;
+        return since[static_cast<std::size_t>(i)
+            * static_cast<std::size_t>(cols) + static_cast<std::size_t>(j)];
+    }
+
+    void Mask::set(Loc const& i, Loc const& j, Time const& s) {
+        if (i < 0 || i >= rows || j < 0 || j >= cols)
+            throw std::out_of_range("Cell outside of the map.");
+        since[static_cast<std::size_t>(i) * static_cast<std::size_t>(cols)
+            + static_cast<std::size_t>(j)] = s;
+    }
+
+    std::array<Loc, 4> Mask::bounds() const {
+        std::array<Loc, 4> res{rows, -1, cols, -1};
+        for (Loc i = 0; i < rows; ++i) {
+            for (Loc j = 0; j < cols; ++j) {
+                if (from(i, j) == 0)
+                    continue;
+                res[0] = std::min(res[0], i);
+                res[1] = std::max(res[1], i);
+                res[2] = std::min(res[2], j);
+                res[3] = std::max(res[3], j);
+            }
+        }
+        return res;
+    }
+}
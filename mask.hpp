@@ -0,0 +1,85 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASK_H
+#define MASK_H
+
+#include <array>
+#include <limits>
+#include <string>
+#include <vector>
+#include "defs.hpp"
+
+namespace dp {
+    /**
+     * A bounded map of cells, e.g. a floor plan: cell (i, j) is row i and
+     * column j of the map, 0 <= i < height, 0 <= j < width. Every cell is
+     * free or blocked from some time on; everything off the map is blocked.
+     */
+    class Mask {
+        /// The number of rows and columns.
+        Loc rows{0}, cols{0};
+        /// The time from which every cell is blocked, row by row.
+        std::vector<Time> since;
+
+    public:
+        /// The time of the cells that are never blocked.
+        static constexpr Time never = std::numeric_limits<Time>::max();
+
+        /**
+         * @brief A map with all cells free.
+         * @param height The number of rows.
+         * @param width The number of columns.
+         */
+        explicit Mask(Loc height, Loc width);
+
+        /**
+         * @brief Read a map from a PGM image, binary (P5) or plain (P2), with
+         * 8 or 16 bits per pixel. A pixel of value v below the maximum value
+         * blocks its cell from time v, so black walls are blocked from the
+         * start, and grey levels encode later times; pixels at the maximum
+         * value (white) are free.
+         * @param path The name of the file.
+         * @return The map.
+         */
+        static Mask read_pgm(std::string const& path);
+
+        /**
+         * @brief The number of rows.
+         */
+        Loc height() const;
+
+        /**
+         * @brief The number of columns.
+         */
+        Loc width() const;
+
+        /**
+         * @brief The time from which (i, j) is blocked, 0 off the map.
+         */
+        Time from(Loc const& i, Loc const& j) const;
+
+        /**
+         * @brief Block (i, j) from time s, or free it with s = `never`.
+         */
+        void set(Loc const& i, Loc const& j, Time const& s);
+
+        /**
+         * @brief The smallest box around the cells that are not blocked from
+         * the start, the only ones that paths can use.
+         * @return The first and last row, the first and last column; empty
+         * (first after last) if all cells are blocked.
+         */
+        std::array<Loc, 4> bounds() const;
+    };
+}
+#endif
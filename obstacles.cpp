@@ -0,0 +1,146 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "obstacles.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace dp {
+    Blocked::Blocked(Loc x, Loc y, Time s): i{std::move(x)}, j{std::move(y)},
+            start{std::move(s)} {
+        // Intentionally left blank.
+    }
+
+    bool Blocked::operator==(Blocked const& o) const {
+        return i == o.i && j == o.j && start == o.start;
+    }
+
+    bool symmetric(std::unordered_set<Blocked> const& cells) {
+        std::unordered_map<std::pair<Loc, Loc>, Time, LocHash> first;
+        for (auto const& cell: cells) {
+            auto [loc, added] = first.emplace(std::make_pair(cell.i, cell.j),
+                cell.start);
+            if (!added && cell.start < loc->second)
+                loc->second = cell.start;
+        }
+        for (auto const& [cell, start]: first) {
+            auto [a, b] = cell;
+            for (auto [x, y]: {std::make_pair(a, b), std::make_pair(b, a)}) {
+                for (auto [u, v]: {std::make_pair(x, y), std::make_pair(-x, y),
+                        std::make_pair(x, -y), std::make_pair(-x, -y)}) {
+                    auto loc = first.find({u, v});
+                    if (loc == first.end() || loc->second != start)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    Obstacles::Obstacles(Time max_time,
+            std::unordered_set<Blocked> const& cells,
+            std::pair<Loc, Loc> const& origin) {
+        auto r = static_cast<Loc>(max_time);
+        top = left = -r;
+        bottom = right = r;
+        auto [is, js] = origin;
+        for (auto const& b: cells) {
+            auto i = static_cast<long long>(b.i) - is;
+            auto j = static_cast<long long>(b.j) - js;
+            if (std::llabs(i) > r || std::llabs(j) > r)
+                continue;
+            auto& s = cell(static_cast<Loc>(i), static_cast<Loc>(j));
+            if (b.start < s)
+                s = b.start;
+        }
+    }
+
+    Obstacles::Obstacles(Time max_time, Mask const& map,
+            std::pair<Loc, Loc> const& origin) {
+        if (max_time > std::numeric_limits<Loc>::max())
+            throw std::length_error("Please pick a lower value of T.");
+        auto r = static_cast<Loc>(max_time);
+        auto [is, js] = origin;
+        auto [i0, i1, j0, j1] = map.bounds();
+        top = std::max(i0 - is, -r);
+        bottom = std::min(i1 - is, r);
+        left = std::max(j0 - js, -r);
+        right = std::min(j1 - js, r);
+        if (map.from(is, js) == 0 || top > 0 || bottom < 0 || left > 0
+                || right < 0)
+            throw std::invalid_argument("The origin is blocked.");
+        for (Loc i = top; i <= bottom; ++i) {
+            for (Loc j = left; j <= right; ++j) {
+                auto s = map.from(i + is, j + js);
+                if (s != never)
+                    cell(i, j) = s;
+            }
+        }
+    }
+
+    Time const* Obstacles::row(Loc const& i) const {
+        assert(i >= top && i <= bottom);
+        return since.data() + static_cast<std::size_t>(i - top)
+            * static_cast<std::size_t>(right - left + 1);
+    }
+
+    Time& Obstacles::cell(Loc const& i, Loc const& j) {
+        auto w = static_cast<std::size_t>(right - left + 1);
+        if (since.empty())
+            since.assign(static_cast<std::size_t>(bottom - top + 1) * w,
+                never);
+        return since[static_cast<std::size_t>(i - top) * w
+            + static_cast<std::size_t>(j - left)];
+    }
+
+    std::array<Loc, 4> Obstacles::bounds() const {
+        return {top, bottom, left, right};
+    }
+
+    bool Obstacles::empty() const {
+        return since.empty();
+    }
+
+    Time Obstacles::from(Loc const& i, Loc const& j) const {
+        if (since.empty() || i < top || i > bottom || j < left || j > right)
+            return never;
+        return row(i)[j - left];
+    }
+
+    bool Obstacles::blocked(Loc const& i, Loc const& j, Time const& t) const {
+        return t >= from(i, j);
+    }
+
+    void Obstacles::set(Loc const& i, Loc const& j, Time const& s) {
+        if (i < top || i > bottom || j < left || j > right || (since.empty()
+                && s == never))
+            return;
+        cell(i, j) = s;
+    }
+
+    bool Obstacles::symmetric() const {
+        auto r = std::max(std::max(-top, bottom), std::max(-left, right));
+        for (Loc i = 0; i <= r && !since.empty(); ++i) {
+            for (Loc j = 0; j <= i; ++j) {
+                auto s = from(i, j);
+                if (from(-i, j) != s || from(i, -j) != s || from(-i, -j) != s
+                        || from(j, i) != s || from(-j, i) != s
+                        || from(j, -i) != s || from(-j, -i) != s)
+                    return false;
+            }
+        }
+        return true;
+    }
+}
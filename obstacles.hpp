@@ -0,0 +1,200 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBSTACLES_H
+#define OBSTACLES_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "defs.hpp"
+#include "layout.hpp"
+#include "mask.hpp"
+
+namespace dp {
+    /**
+     * The description of a blocked cell.
+     */
+    struct Blocked {
+        /// The location of the blocked cell.
+        Loc i, j;
+        /// The step from which the cell is blocked.
+        Time start;
+
+        /**
+         * @brief Initialise a blocked cell.
+         * @param x First dimension.
+         * @param y Second dimension.
+         * @param s Starting from this time, the cell is blocked.
+         */
+        Blocked(Loc x, Loc y, Time s);
+
+        /**
+         * @brief Compare two instances. A set may hold the same location with
+         * several times; the cell is then blocked from the earliest one.
+         * @param o The other instance.
+         * @return `true` iff (i, j, start) = (o.i, o.j, o.start).
+         */
+        bool operator==(Blocked const& o) const;
+    };
+}
+
+// Specialise std::hash to dp::Blocked for use in unordered_set.
+namespace std {
+    template<> struct hash<dp::Blocked> {
+        std::size_t operator()(dp::Blocked const& t) const noexcept {
+            return dp::hash_helper(t.i, t.j);
+        }
+    };
+}
+
+namespace dp {
+    /**
+     * @brief Check if a set of blocked cells looks the same after flipping
+     * the signs of the coordinates or swapping them, with the same times.
+     * @param cells The set of blocked cells, relative to the origin.
+     * @return True iff the set is symmetric around (0, 0).
+     */
+    bool symmetric(std::unordered_set<Blocked> const& cells);
+
+    /**
+     * The blocked cells within reach of T steps, compiled into a dense grid
+     * with, for every -T <= i, j <= T, the time from which (i, j) is blocked.
+     * A cell that is listed with several times is blocked from the earliest.
+     * The rows of the grid are contiguous, so that a row of a layer can be
+     * masked in one pass, see `clear`. For a bounded map, the grid only
+     * covers the part of the map within reach.
+     */
+    class Obstacles {
+        /// The first and last row and column of the grid.
+        Loc top{0}, bottom{0}, left{0}, right{0};
+        /// The grid, row by row; empty if no cell is blocked.
+        std::vector<Time> since;
+
+        /**
+         * @brief The entry for (i, left) in the grid; top <= i <= bottom.
+         */
+        Time const* row(Loc const& i) const;
+
+        /**
+         * @brief The entry for (i, j) in the grid, which must not be empty.
+         */
+        Time& cell(Loc const& i, Loc const& j);
+
+    public:
+        /// The time of the cells that are never blocked.
+        static constexpr Time never = std::numeric_limits<Time>::max();
+
+        /**
+         * @brief No blocked cells.
+         */
+        Obstacles() = default;
+
+        /**
+         * @brief Compile a set of blocked cells.
+         * @param max_time The value of T; cells further away are dropped.
+         * @param cells The set of blocked cells.
+         * @param origin The cell that becomes (0, 0) in the grid.
+         */
+        Obstacles(Time max_time, std::unordered_set<Blocked> const& cells,
+            std::pair<Loc, Loc> const& origin = {0, 0});
+
+        /**
+         * @brief Compile the blocked cells of a map, see `Mask`; throw an
+         * exception if the origin is blocked from the start.
+         * @param max_time The value of T; cells further away are dropped.
+         * @param map The map.
+         * @param origin The cell of the map that becomes (0, 0) in the grid,
+         * which must not be blocked at time 0.
+         */
+        Obstacles(Time max_time, Mask const& map,
+            std::pair<Loc, Loc> const& origin);
+
+        /**
+         * @brief The first and last row, the first and last column of the
+         * grid; cells outside of it are never blocked.
+         */
+        std::array<Loc, 4> bounds() const;
+
+        /**
+         * @brief Whether no cell is blocked.
+         */
+        bool empty() const;
+
+        /**
+         * @brief The time from which (i, j) is blocked, `never` if it is not
+         * or if it is outside of the grid.
+         */
+        Time from(Loc const& i, Loc const& j) const;
+
+        /**
+         * @brief Whether (i, j) is blocked at time t.
+         */
+        bool blocked(Loc const& i, Loc const& j, Time const& t) const;
+
+        /**
+         * @brief Block (i, j) from time s instead, or unblock it with
+         * s = `never`; cells outside of the grid are ignored.
+         */
+        void set(Loc const& i, Loc const& j, Time const& s);
+
+        /**
+         * @brief Whether the grid looks the same after flipping the signs of
+         * the coordinates or swapping them, see `symmetric`.
+         */
+        bool symmetric() const;
+
+        /**
+         * @brief Set the cells of rows `first` to `last` of layer t that are
+         * blocked at time t to 0.
+         * @param layout The layout of the table, with the same T or a
+         * smaller one, within the grid; folded layouts need a symmetric grid.
+         * @param t The layer.
+         * @param first The first row.
+         * @param last The last row.
+         * @param cells The first cell of layer t.
+         */
+        template<typename C>
+        void clear(Layout const& layout, Time const& t, Loc const& first,
+                Loc const& last, C* cells) const {
+            if (since.empty())
+                return;
+            auto lo_row = std::max(first, layout.first_row(t));
+            auto hi_row = std::min(last, layout.last_row(t));
+            for (Loc i = lo_row; i <= hi_row; ++i) {
+                auto const& span = layout.row(i, t);
+                if (span.lo > span.hi)
+                    continue;
+                auto const* s = row(i) + (span.lo - left);
+                auto* d = cells + span.offset;
+                auto n = static_cast<std::size_t>(span.hi - span.lo) + 1;
+                // Machine counts are stored back unconditionally, so the
+                // loop compiles to masks; `Cnt` keeps the branch, as clearing
+                // a bignum is a call.
+                if constexpr (!std::is_same_v<C, Cnt>) {
+                    for (std::size_t k = 0; k < n; ++k)
+                        d[k] = s[k] <= t ? C{0} : d[k];
+                } else {
+                    for (std::size_t k = 0; k < n; ++k)
+                        if (s[k] <= t)
+                            d[k] = 0;
+                }
+            }
+        }
+    };
+}
+#endif
@@ -66,12 +66,16 @@ def plot(filename, logscale):
     plt.close()
 
 def traj(cnt, si, sj, ei, ej):
-    for i in range(cnt):
-        filename = Path('.') / 'data' / ('traj' + str(i))
-        if filename.is_file():
-            t = np.loadtxt(filename, dtype=int)
+    filename = Path('.') / 'data' / 'trajs'
+    if filename.is_file():
+        with open(filename) as f:
+            n, T = map(int, f.readline().split())
+        if n > 0:
+            t = np.loadtxt(filename, dtype=int, skiprows=1, ndmin=2)
+            t = t.reshape(n, T + 1, 2)
+        for i in range(min(cnt, n)):
             jitter = .1 * (i - cnt // 2)
-            data = t + jitter
+            data = t[i] + jitter
             plt.plot(data[:,0], data[:,1], lw=.8)
     plt.plot(si, sj, marker='o', markersize=5, color='black')
     plt.plot(ei, ej, marker='x', markersize=5, color='black')
@@ -0,0 +1,91 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "pool.hpp"
+
+namespace dp {
+    Pool::Pool(unsigned threads) {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        for (unsigned id = 1; id < threads; ++id)
+            workers.emplace_back(&Pool::work, this, id);
+    }
+
+    Pool::~Pool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& worker: workers)
+            worker.join();
+    }
+
+    unsigned Pool::size() const {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    void Pool::work(unsigned id) {
+        std::size_t seen = 0;
+        while (true) {
+            std::function<void(unsigned)> const* f;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || round != seen; });
+                if (stop)
+                    return;
+                seen = round;
+                f = job;
+            }
+            std::exception_ptr e;
+            try {
+                (*f)(id);
+            }
+            catch (...) {
+                e = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (e && !error)
+                error = e;
+            if (--pending == 0)
+                done.notify_one();
+        }
+    }
+
+    void Pool::run(std::function<void(unsigned)> const& f) {
+        if (workers.empty()) {
+            f(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &f;
+            pending = static_cast<unsigned>(workers.size());
+            error = nullptr;
+            ++round;
+        }
+        wake.notify_all();
+        std::exception_ptr e;
+        try {
+            f(0);
+        }
+        catch (...) {
+            e = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return pending == 0; });
+        if (!e)
+            e = error;
+        if (e)
+            std::rethrow_exception(e);
+    }
+}
@@ -0,0 +1,83 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dp {
+    /**
+     * A fixed set of worker threads that run one job at a time, each worker
+     * with its own index; the calling thread takes part as worker 0.
+     */
+    class Pool {
+        /// The worker threads, for indices 1 and up.
+        std::vector<std::thread> workers;
+        /// Guards everything below.
+        std::mutex mutex;
+        /// Signals a new job, or stopping, to the workers.
+        std::condition_variable wake;
+        /// Signals the end of the job to the caller.
+        std::condition_variable done;
+        /// The current job.
+        std::function<void(unsigned)> const* job{nullptr};
+        /// The number of jobs started so far.
+        std::size_t round{0};
+        /// The number of workers still busy with the current job.
+        unsigned pending{0};
+        /// The first exception thrown by the current job.
+        std::exception_ptr error;
+        /// Whether the workers should exit.
+        bool stop{false};
+
+        /**
+         * @brief The loop of worker `id`: wait for a job, run it, repeat.
+         */
+        void work(unsigned id);
+
+    public:
+        /**
+         * @brief Start the workers.
+         * @param threads The total number of threads, including the caller;
+         * 0 for one per hardware thread.
+         */
+        explicit Pool(unsigned threads = 0);
+
+        Pool(Pool const&) = delete;
+        Pool& operator=(Pool const&) = delete;
+
+        /**
+         * @brief Stop the workers, waiting for them to exit.
+         */
+        ~Pool();
+
+        /**
+         * @brief The number of threads, including the caller.
+         */
+        unsigned size() const;
+
+        /**
+         * @brief Call f(w) for every worker index 0 <= w < size() in parallel
+         * and wait for all calls to return; rethrow the first exception.
+         * @param f The job.
+         */
+        void run(std::function<void(unsigned)> const& f);
+    };
+}
+#endif
@@ -12,62 +12,319 @@
 
 #include "problems.hpp"
 
-#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <stdexcept>
+#include "cache.hpp"
+#include "pool.hpp"
+#include "spill.hpp"
+#include "stencil_defs.hpp"
+#include "stream.hpp"
+
+namespace {
+    using ::dp::BasicDP, ::dp::Time, ::dp::Loc;
+
+    /**
+     * @brief Add the counts of the paths from start to end in T steps that
+     * are in (x, y) at time t, for the first time, to the grid, for all
+     * (x, y) within reach.
+     *
+     * These are the paths from start that reach (x, y) first at time t,
+     * times the paths from (x, y) to end in T - t steps. Both layers come
+     * from DPs that start in (0, 0) and are neither shifted nor flipped, so
+     * that they can be shared between start and end points.
+     * @param res The grid to add to.
+     * @param a Layer t of the DP with (0, 0) blocked from time 1.
+     * @param b Layer T - t of the DP of all paths.
+     * @param start The starting point of the paths.
+     * @param end The final point of the paths.
+     * @param t The time.
+     * @param T The number of steps.
+     */
+    template<typename C>
+    void add_layer(dp::BasicGrid<C>& res, dp::BasicLayer<C> const& a,
+            dp::BasicLayer<C> const& b, std::pair<Loc, Loc> const& start,
+            std::pair<Loc, Loc> const& end, Time const& t, Time const& T) {
+        auto [si, sj] = start;
+        auto [ei, ej] = end;
+        auto sT = static_cast<Loc>(T);
+        auto st = static_cast<Loc>(t);
+        // Only the cells within t steps of start and T - t steps of end.
+        for (Loc i = si - st; i <= si + st; ++i) {
+            auto ra = st - std::abs(i - si);
+            auto rb = sT - st - std::abs(i - ei);
+            if (rb < 0)
+                continue;
+            auto lo = std::max(sj - ra, ej - rb);
+            auto hi = std::min(sj + ra, ej + rb);
+            for (Loc j = lo; j <= hi; ++j)
+                dp::Count<C>::add_mul(res.at(i, j), a.at(i - si, j - sj),
+                    b.at(i - ei, j - ej));
+        }
+    }
+
+    /**
+     * @brief Add the counts of the paths from start to end in T steps that
+     * visit (x, y) to the grid, for all (x, y) within reach.
+     *
+     * A path is counted at the first time s it is in (x, y), see
+     * `add_layer`.
+     * @param res The grid to add to.
+     * @param first_visit The DP with (0, 0) blocked from time 1, at least T
+     * steps.
+     * @param all The DP of all paths, at least T steps.
+     * @param start The starting point of the paths.
+     * @param end The final point of the paths.
+     * @param T The number of steps.
+     */
+    template<typename C>
+    void add_visits(dp::BasicGrid<C>& res, BasicDP<C> const& first_visit,
+            BasicDP<C> const& all, std::pair<Loc, Loc> const& start,
+            std::pair<Loc, Loc> const& end, Time const& T) {
+        for (Time t = 0; t <= T; ++t)
+            add_layer(res, first_visit.layer(t), all.layer(T - t), start, end,
+                t, T);
+    }
+
+}
 
 namespace prob {
-    using ::dp::DP, ::dp::Time, ::dp::Loc, ::dp::Cnt, ::dp::Blocked;
-    DP all_paths(Time T, std::pair<Loc, Loc> start,
-            std::unordered_set<Blocked> const& blocked) {
-        DP res(std::move(T), dp::uniform_prop, std::move(start), blocked);
+    using ::dp::BasicDP, ::dp::Time, ::dp::Loc, ::dp::Cnt, ::dp::Blocked,
+        ::dp::Wide;
+    Cnt count_paths(Time T, std::pair<Loc, Loc> start,
+            std::pair<Loc, Loc> end) {
+        auto [si, sj] = start;
+        auto [ei, ej] = end;
+        auto x = std::llabs(static_cast<long long>(ei) - si);
+        auto y = std::llabs(static_cast<long long>(ej) - sj);
+        if (x + y > T)
+            return 0;
+
+        auto a = static_cast<Time>(x + y);
+        auto b = static_cast<Time>(std::llabs(x - y));
+        // The term for m moves is C(T, m) C(m, i) C(m, j), with i and j the
+        // steps along the diagonals; only m of the parity of x + y count.
+        auto& f = dp::Factorials::global();
+        auto m = a, i = a, j = (a + b) / 2;
+        Cnt term = f.binomial(T, m) * f.binomial(m, i) * f.binomial(m, j);
+        Cnt res = term, num, den;
+        for (; m + 2 <= T; m += 2) {
+            // From m to m + 2 moves, i and j grow by one each.
+            num = Cnt(T - m) * (T - m - 1) * (m + 1) * (m + 2);
+            den = Cnt(i + 1) * (m - i + 1) * (j + 1) * (m - j + 1);
+            term *= num;
+            mpz_divexact(term.get_mpz_t(), term.get_mpz_t(), den.get_mpz_t());
+            res += term;
+            ++i;
+            ++j;
+        }
         return res;
     }
 
-    DP visit_all(Time T, std::pair<Loc, Loc> start, std::pair<Loc, Loc> end) {
-        DP first_visit(T, dp::uniform_prop, {0, 0}, {{0, 0, 1}});
+    template<typename C>
+    void sweep_paths(Time T, std::pair<Loc, Loc> start,
+            std::unordered_set<Blocked> const& blocked,
+            std::function<void(dp::BasicLayer<C> const&)> const& sink) {
+        dp::BasicSweep<C> sweep(T, dp::Lazy5{}, std::move(start), blocked);
+        sink(sweep.layer(0));
+        while (sweep.time() < T) {
+            sweep.advance();
+            sink(sweep.layer(sweep.time()));
+        }
+    }
+
+    template<typename C>
+    BasicDP<C> visit_all(Time T, std::pair<Loc, Loc> start,
+            std::pair<Loc, Loc> end, unsigned threads) {
+        BasicDP<C> first_visit(T, dp::Lazy5{}, {0, 0}, {{0, 0, 1}},
+            dp::Storage::octant, threads);
         first_visit.set_shift(std::move(start));
         first_visit.flip_coords();
-        DP rest(std::move(T), dp::uniform_prop);
+        BasicDP<C> rest(std::move(T), dp::Lazy5{}, {0, 0}, {},
+            dp::Storage::octant, threads);
         rest.flip_time();
         rest.set_shift(std::move(end));
         return first_visit * rest;
     }
 
-    std::vector<std::pair<Loc, Loc>> generate_path(Time const& T,
-            DP const& paths, std::pair<Loc, Loc> const& end) {
-        auto [ci, cj] = end;
-        if (paths.at(ci, cj, T) == 0)
-            return {};
-
-        std::vector<std::pair<Loc, Loc>> ret(T + 1);
-        std::random_device rd;
-        std::mt19937_64 helper(rd());
-        std::uniform_int_distribution<unsigned int> seeder;
-        gmp_randclass gen(gmp_randinit_mt);
-        gen.seed(seeder(helper));
-        for (Time t = T; t > 0; --t) {
-            ret[t] = {ci, cj};
-            Cnt total = paths.at(ci, cj, t);
-            Cnt prev_counts[] = {paths.at(ci, cj, t - 1),
-                paths.at(ci - 1, cj, t - 1), paths.at(ci, cj - 1, t - 1),
-                paths.at(ci + 1, cj, t - 1), paths.at(ci, cj + 1, t - 1)};
-
-            Cnt rchoice = gen.get_z_range(total);
-            unsigned choice = 0;
-            while (rchoice >= prev_counts[choice]) {
-                rchoice -= prev_counts[choice];
-                ++choice;
-            }
-
-            switch (choice) {
-                case 0: break;
-                case 1: --ci; break;
-                case 2: --cj; break;
-                case 3: ++ci; break;
-                case 4: ++cj; break;
-                default: break;
-            }
+    template<typename C>
+    dp::BasicGrid<C> visit_grid(Time T, std::pair<Loc, Loc> start,
+            std::pair<Loc, Loc> end, unsigned threads) {
+        auto& cache = dp::BasicCache<C>::global();
+        auto first_visit = cache.table(T, {{0, 0, 1}}, threads);
+        auto all = cache.table(T, {}, threads);
+        dp::BasicGrid<C> res(static_cast<Loc>(T), start);
+        add_visits(res, *first_visit, *all, start, end, T);
+        return res;
+    }
+
+    template<typename C>
+    dp::BasicGrid<C> visit_grid_spilled(Time T, std::pair<Loc, Loc> start,
+            std::pair<Loc, Loc> end, std::string const& dir) {
+        dp::BasicSpill<C> all(T, dp::Lazy5{}, dir, {0, 0}, {}, 2,
+            dp::Storage::octant);
+        dp::BasicSweep<C> first_visit(T, dp::Lazy5{}, {0, 0}, {{0, 0, 1}}, 2,
+            dp::Storage::octant);
+        dp::BasicGrid<C> res(static_cast<Loc>(T), start);
+        for (Time t = 0; t <= T; ++t) {
+            if (t > 0)
+                first_visit.advance();
+            auto b = all.layer(T - t);
+            // Read the next layer back while this one is added up.
+            if (t < T)
+                all.prefetch(T - t - 1);
+            add_layer(res, first_visit.layer(t), b, start, end, t, T);
         }
-        ret[0] = {ci, cj};
-        return ret;
+        return res;
     }
+
+    dp::BasicGrid<double> visit_probabilities(Time T,
+            std::pair<Loc, Loc> start, std::pair<Loc, Loc> end,
+            unsigned threads) {
+        auto& cache = dp::BasicCache<double>::global();
+        auto first_visit = cache.table(T, {{0, 0, 1}}, threads);
+        auto all = cache.table(T, {}, threads);
+        auto [si, sj] = start;
+        auto [ei, ej] = end;
+        auto total = all->at(ei - si, ej - sj, T);
+        if (total == 0)
+            throw std::invalid_argument("The end point cannot be reached.");
+
+        dp::BasicGrid<double> res(static_cast<Loc>(T), start);
+        add_visits(res, *first_visit, *all, start, end, T);
+        for (Loc i = si - static_cast<Loc>(T); i <= si + static_cast<Loc>(T);
+                ++i)
+            for (Loc j = sj - static_cast<Loc>(T);
+                    j <= sj + static_cast<Loc>(T); ++j)
+                res.at(i, j) /= total;
+        return res;
+    }
+
+    template<typename C>
+    void visit_batch(std::vector<Gap> const& gaps,
+            std::function<void(std::size_t, dp::BasicGrid<C> const&)> const&
+            sink, std::function<void(std::size_t, std::size_t)> const& progress,
+            unsigned threads) {
+        if (gaps.empty())
+            return;
+        Time last = 0;
+        for (auto const& gap: gaps)
+            last = std::max(last, gap.T);
+        auto& cache = dp::BasicCache<C>::global();
+        auto first_visit = cache.table(last, {{0, 0, 1}}, threads);
+        auto all = cache.table(last, {}, threads);
+
+        std::atomic<std::size_t> next{0};
+        std::size_t done = 0;
+        std::mutex mutex;
+        dp::Pool pool(threads);
+        pool.run([&](unsigned) {
+                for (auto k = next++; k < gaps.size(); k = next++) {
+                    auto const& gap = gaps[k];
+                    dp::BasicGrid<C> res(static_cast<Loc>(gap.T), gap.start);
+                    add_visits(res, *first_visit, *all, gap.start, gap.end,
+                        gap.T);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sink(k, res);
+                    if (progress)
+                        progress(++done, gaps.size());
+                }
+            });
+    }
+
+    template<typename C>
+    void visit_tables(Time first, Time last, std::function<void(Time const&,
+            std::pair<Loc, Loc> const&, dp::BasicGrid<C> const&)> const& sink,
+            std::function<void(std::size_t, std::size_t)> const& progress,
+            unsigned threads) {
+        std::vector<Gap> gaps;
+        for (auto t = first; t <= last; ++t)
+            for (Loc x = 0; x <= static_cast<Loc>(t); ++x)
+                for (Loc y = 0; y <= std::min(x, static_cast<Loc>(t) - x);
+                        ++y)
+                    gaps.push_back({{0, 0}, {x, y}, t});
+        visit_batch<C>(gaps, [&](std::size_t k,
+                dp::BasicGrid<C> const& res) {
+                sink(gaps[k].T, gaps[k].end, res);
+            }, progress, threads);
+    }
+
+    template<typename C>
+    std::vector<std::pair<Loc, Loc>> generate_paths(Time const& T,
+            dp::BasicView<C> const& paths, std::pair<Loc, Loc> const& end,
+            std::size_t count, std::uint64_t seed, unsigned threads) {
+        return walk_back_many<dp::Lazy5>(T, paths, end, count, seed, threads);
+    }
+
+    dp::RnsDP visit_all_rns(Time T, std::pair<Loc, Loc> start,
+            std::pair<Loc, Loc> end) {
+        dp::RnsDP first_visit(T, dp::Lazy5{}, {0, 0}, {{0, 0, 1}},
+            dp::Storage::octant);
+        first_visit.set_shift(std::move(start));
+        first_visit.flip_coords();
+        dp::RnsDP rest(std::move(T), dp::Lazy5{}, {0, 0}, {},
+            dp::Storage::octant);
+        rest.flip_time();
+        rest.set_shift(std::move(end));
+        return first_visit * rest;
+    }
+
+// The DP of all paths for every compiled stencil.
+#define PROB_ALL_PATHS(C, S) \
+    template BasicDP<C> all_paths<C, S>(Time, std::pair<Loc, Loc>, \
+        std::unordered_set<Blocked> const&, dp::Storage, unsigned);
+// Drawing paths for every compiled stencil.
+#define PROB_PATHS(C, S) \
+    template std::vector<std::pair<Loc, Loc>> generate_path<C, S>( \
+        Time const&, BasicDP<C> const&, std::pair<Loc, Loc> const&); \
+    template std::vector<std::pair<Loc, Loc>> generate_paths<C, S>( \
+        Time const&, BasicDP<C> const&, std::pair<Loc, Loc> const&, \
+        std::size_t, std::uint64_t, unsigned); \
+    template std::vector<std::pair<Loc, Loc>> \
+        generate_paths_checkpointed<C, S>(Time, std::pair<Loc, Loc>, \
+        std::pair<Loc, Loc> const&, std::size_t, std::uint64_t, \
+        std::unordered_set<Blocked> const&, Time);
+#define PROB_STENCILS(M, C) \
+    M(C, dp::Walk4) M(C, dp::Lazy5) M(C, dp::King8) M(C, dp::Lazy9)
+// The functions for every count type, including probabilities.
+#define PROB_COUNT(C) \
+    PROB_STENCILS(PROB_ALL_PATHS, C) \
+    template BasicDP<C> visit_all(Time, std::pair<Loc, Loc>, \
+        std::pair<Loc, Loc>, unsigned); \
+    template dp::BasicGrid<C> visit_grid(Time, std::pair<Loc, Loc>, \
+        std::pair<Loc, Loc>, unsigned); \
+    template void visit_batch(std::vector<Gap> const&, \
+        std::function<void(std::size_t, dp::BasicGrid<C> const&)> const&, \
+        std::function<void(std::size_t, std::size_t)> const&, unsigned);
+// The functions for exact counts only.
+#define PROB_EXACT(C) \
+    PROB_STENCILS(PROB_PATHS, C) \
+    template void sweep_paths(Time, std::pair<Loc, Loc>, \
+        std::unordered_set<Blocked> const&, \
+        std::function<void(dp::BasicLayer<C> const&)> const&); \
+    template dp::BasicGrid<C> visit_grid_spilled(Time, std::pair<Loc, Loc>, \
+        std::pair<Loc, Loc>, std::string const&); \
+    template std::vector<std::pair<Loc, Loc>> generate_paths(Time const&, \
+        dp::BasicView<C> const&, std::pair<Loc, Loc> const&, std::size_t, \
+        std::uint64_t, unsigned); \
+    template void visit_tables(Time, Time, std::function<void(Time const&, \
+        std::pair<Loc, Loc> const&, dp::BasicGrid<C> const&)> const&, \
+        std::function<void(std::size_t, std::size_t)> const&, unsigned);
+
+    PROB_COUNT(std::uint64_t)
+    PROB_COUNT(Wide)
+    PROB_COUNT(Cnt)
+    PROB_COUNT(double)
+
+    PROB_EXACT(std::uint64_t)
+    PROB_EXACT(Wide)
+    PROB_EXACT(Cnt)
+
+#undef PROB_EXACT
+#undef PROB_COUNT
+#undef PROB_STENCILS
+#undef PROB_PATHS
+#undef PROB_ALL_PATHS
 }
@@ -13,22 +13,81 @@
 #ifndef PROBLEMS_H
 #define PROBLEMS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
 #include <unordered_set>
 #include <utility>
 #include <vector>
+#include "cache.hpp"
 #include "dp.hpp"
+#include "layout.hpp"
+#include "rns.hpp"
 
 namespace prob {
+    /*
+     * All functions are templates over the count type C, see `dp::Count`;
+     * every count they compute is at most `dp::path_bound(T)`, so
+     * `dp::with_count(dp::path_bound(T), ...)` picks an exact one. Those that
+     * take a stencil S, the move model, default to `dp::Lazy5` and are
+     * instantiated for the stencils of stencil.hpp; for these, the bound is
+     * `dp::path_bound(T, dp::stencil_weight<S>())`.
+     */
+
     /**
      * @brief For all possible coordinates (x, y) and for all time steps
      * 0 <= t <= T, count the paths from start to (x, y) in t steps.
      * @param T The maximum number of steps / time limit.
      * @param start The origin, from which we start the paths.
      * @param blocked The set of blocked cells, none by default.
+     * @param storage Which cells to store; with no obstacles, or symmetric
+     * ones, `Storage::octant` takes 8 times less memory.
+     * @param threads The number of threads, 0 for one per hardware thread.
      * @return An instance of `DP` with the counts, accessible with at(x, y, t).
      */
-    dp::DP all_paths(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
-        std::unordered_set<dp::Blocked> const& blocked = {});
+    template<typename C = dp::Cnt, typename S = dp::Lazy5>
+    dp::BasicDP<C> all_paths(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+        std::unordered_set<dp::Blocked> const& blocked = {},
+        dp::Storage storage = dp::Storage::diamond, unsigned threads = 1);
+
+    /**
+     * @brief Count the paths from start to end in T steps without obstacles,
+     * as `all_paths(T, start).at(end, T)`, without computing a table.
+     *
+     * A path with m moves and T - m stays is a walk of m steps to the
+     * neighbours, and rotating the grid by 45 degrees splits those into two
+     * independent walks along the diagonals, so the count is the sum over m
+     * of C(T, m) C(m, (m + x + y) / 2) C(m, (m + x - y) / 2), for the offset
+     * (x, y) from start to end. The first term comes from the factorials of
+     * `dp::Factorials::global()`, and every next one from the one before by
+     * a few small factors, so this takes O(T) operations on numbers of
+     * O(T) bits rather than a table of O(T^3) cells.
+     * @param T The number of steps.
+     * @param start The starting point of the paths.
+     * @param end The final point of the paths.
+     * @return The number of paths.
+     */
+    dp::Cnt count_paths(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+        std::pair<dp::Loc, dp::Loc> end);
+
+    /**
+     * @brief For all possible coordinates (x, y) and for all time steps
+     * 0 <= t <= T, count the paths from start to (x, y) in t steps, passing
+     * the layers to `sink` in order of t instead of storing them.
+     *
+     * Only two layers are in memory at any time, so this is the way to go
+     * when only layer T, or a few layers, are needed.
+     * @param T The maximum number of steps / time limit.
+     * @param start The origin, from which we start the paths.
+     * @param blocked The set of blocked cells.
+     * @param sink Called for every 0 <= t <= T with the counts at time t,
+     * accessible with at(x, y); the layer is only valid during the call.
+     */
+    template<typename C = dp::Cnt>
+    void sweep_paths(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+        std::unordered_set<dp::Blocked> const& blocked,
+        std::function<void(dp::BasicLayer<C> const&)> const& sink);
 
     /**
      * @brief For all possible coordinates (a, b) and for all time steps
@@ -39,9 +98,137 @@ namespace prob {
      * @param T The maximum number of steps / time limit.
      * @param start The origin, from which we start the paths.
      * @param end The final point of the paths.
+     * @param threads The number of threads, 0 for one per hardware thread.
      * @return An instance of `DP` with the counts, accessible with at(x, y, t).
      */
-    dp::DP visit_all(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+    template<typename C = dp::Cnt>
+    dp::BasicDP<C> visit_all(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+        std::pair<dp::Loc, dp::Loc> end, unsigned threads = 1);
+
+    /**
+     * @brief For all possible coordinates (x, y), count the paths from start
+     * to end in T steps that visit (x, y), i.e. `visit_all(...).flatten(T)`.
+     *
+     * The matching layers of the two DPs are multiplied one time step at a
+     * time and added straight into the grid, so the product DP is never
+     * stored. Both DPs come from `dp::BasicCache<C>::global()`, so repeated
+     * calls only pay for the product.
+     * @param T The maximum number of steps / time limit.
+     * @param start The origin, from which we start the paths.
+     * @param end The final point of the paths.
+     * @param threads The number of threads, 0 for one per hardware thread.
+     * @return The visit counts around start, accessible with at(x, y).
+     */
+    template<typename C = dp::Cnt>
+    dp::BasicGrid<C> visit_grid(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+        std::pair<dp::Loc, dp::Loc> end, unsigned threads = 1);
+
+    /**
+     * @brief The same as `visit_grid`, for T so large that the DPs do not fit
+     * in memory.
+     *
+     * The DP of all paths is spilled to a file in `dir`, see
+     * `dp::BasicSpill`, and read back one layer at a time from T down to 0,
+     * each layer read ahead while the one before is added up. The DP of the
+     * first visits is swept forward at the same time, see `dp::BasicSweep`.
+     * Only a few layers are in memory at a time, O(T^2) cells, while the
+     * file takes about as much space as one of the DPs in octant mode.
+     * @param T The maximum number of steps / time limit.
+     * @param start The origin, from which we start the paths.
+     * @param end The final point of the paths.
+     * @param dir The directory for the spilled layers.
+     * @return The visit counts around start, accessible with at(x, y).
+     */
+    template<typename C = dp::Cnt>
+    dp::BasicGrid<C> visit_grid_spilled(dp::Time T,
+        std::pair<dp::Loc, dp::Loc> start, std::pair<dp::Loc, dp::Loc> end,
+        std::string const& dir);
+
+    /**
+     * @brief For all possible coordinates (x, y), the probability that a
+     * uniform walk from start that is in end after T steps has visited
+     * (x, y), i.e. `visit_grid<double>` divided by the probability of ending
+     * in end.
+     *
+     * This works in floating point, see `dp::Count<double>`, so it is far
+     * faster than the exact counts and reaches much larger T; it is accurate
+     * to about 1e-12 relative to the largest value, as long as end is not so
+     * far out that reaching it has a probability below `DBL_MIN`.
+     * @param T The maximum number of steps / time limit.
+     * @param start The origin, from which we start the paths.
+     * @param end The final point of the paths.
+     * @param threads The number of threads, 0 for one per hardware thread.
+     * @return The visit probabilities around start, accessible with at(x, y).
+     */
+    dp::BasicGrid<double> visit_probabilities(dp::Time T,
+        std::pair<dp::Loc, dp::Loc> start, std::pair<dp::Loc, dp::Loc> end,
+        unsigned threads = 1);
+
+    /**
+     * A query for `visit_batch`: the paths from `start` to `end` in `T`
+     * steps, e.g. a gap in a trajectory.
+     */
+    struct Gap {
+        std::pair<dp::Loc, dp::Loc> start, end;
+        dp::Time T;
+    };
+
+    /**
+     * @brief For every gap, count the paths that visit each cell, as
+     * `visit_grid(gap.T, gap.start, gap.end)`.
+     *
+     * Without obstacles, the two DPs that the counts are made of are
+     * translations of tables around (0, 0), so they are computed once, for
+     * the largest T, and shared by all the gaps; they are taken from
+     * `dp::BasicCache<C>::global()`. The gaps are then split between the
+     * threads.
+     * @param gaps The queries.
+     * @param sink Called with the index of a gap and its visit counts around
+     * its start, accessible with at(i, j), for every gap; the calls do not
+     * overlap, but come in no particular order.
+     * @param progress If set, called after every gap with the number of gaps
+     * done and the total number.
+     * @param threads The number of threads, 0 for one per hardware thread.
+     */
+    template<typename C = dp::Cnt>
+    void visit_batch(std::vector<Gap> const& gaps,
+        std::function<void(std::size_t, dp::BasicGrid<C> const&)> const& sink,
+        std::function<void(std::size_t, std::size_t)> const& progress = {},
+        unsigned threads = 1);
+
+    /**
+     * @brief For every 0 <= y <= x with x + y <= t and first <= t <= last,
+     * count the paths from (0, 0) to (x, y) in t steps that visit each cell,
+     * as `visit_grid(t, {0, 0}, {x, y})`; other end points follow by
+     * symmetry, and those with x + y > t have no paths.
+     *
+     * The tables are computed as one batch, see `visit_batch`.
+     * @param first The smallest t.
+     * @param last The largest t; counts are at most `dp::path_bound(last)`.
+     * @param sink Called with t, (x, y) and the visit counts around (0, 0),
+     * accessible with at(i, j), for every table; the calls do not overlap,
+     * but come in no particular order.
+     * @param progress If set, called after every table with the number of
+     * tables done and the total number.
+     * @param threads The number of threads, 0 for one per hardware thread.
+     */
+    template<typename C = dp::Cnt>
+    void visit_tables(dp::Time first, dp::Time last,
+        std::function<void(dp::Time const&, std::pair<dp::Loc, dp::Loc> const&,
+        dp::BasicGrid<C> const&)> const& sink,
+        std::function<void(std::size_t, std::size_t)> const& progress = {},
+        unsigned threads = 1);
+
+    /**
+     * @brief The same as `visit_all`, computed modulo several primes, see
+     * `dp::RnsDP`; the fastest exact way for large T.
+     * @param T The maximum number of steps / time limit.
+     * @param start The origin, from which we start the paths.
+     * @param end The final point of the paths.
+     * @return An instance of `RnsDP` with the counts, accessible with
+     * at(x, y, t).
+     */
+    dp::RnsDP visit_all_rns(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
         std::pair<dp::Loc, dp::Loc> end);
 
     /**
@@ -50,8 +237,7 @@ namespace prob {
      * 
      * Generate a random trajectory of exactly length `T` from `start` to `end`,
      * if it is possible. The `paths` DP should be the output of `all_paths`
-     * with the same or larger `T` and the same `start`. We assume that the path
-     * can only move to neighbouring nodes in one time step.
+     * with the same or larger `T`, the same `start` and the same stencil S.
      * @param T The number of time steps in the trajectory.
      * @param paths The DP for computing all paths from `start`.
      * @param start The starting point of the paths.
@@ -60,7 +246,62 @@ namespace prob {
      * the kth item is the (i, j)-coordinate at time k; or an empty trajectory
      * if the path is impossible.
      */
+    template<typename C = dp::Cnt, typename S = dp::Lazy5>
     std::vector<std::pair<dp::Loc, dp::Loc>> generate_path(dp::Time const& T,
-        dp::DP const& paths, std::pair<dp::Loc, dp::Loc> const& end);
+        dp::BasicDP<C> const& paths, std::pair<dp::Loc, dp::Loc> const& end);
+
+    /**
+     * @brief Generate `count` paths from `start` to `end` in `T` steps as in
+     * `generate_path`, in parallel and reproducibly.
+     *
+     * Path k draws from its own stream of random numbers, determined by
+     * `seed` and k only, so the output does not depend on `threads`.
+     * @param T The number of time steps in the trajectories.
+     * @param paths The DP for computing all paths from `start`.
+     * @param end The endpoint of the generated trajectories.
+     * @param count The number of trajectories.
+     * @param seed The seed of the random streams.
+     * @param threads The number of threads, 0 for one per hardware thread.
+     * @return The trajectories one after another, so the kth item of path p
+     * is at p * (T + 1) + k; or an empty vector if the path is impossible.
+     */
+    template<typename C = dp::Cnt, typename S = dp::Lazy5>
+    std::vector<std::pair<dp::Loc, dp::Loc>> generate_paths(dp::Time const& T,
+        dp::BasicDP<C> const& paths, std::pair<dp::Loc, dp::Loc> const& end,
+        std::size_t count, std::uint64_t seed, unsigned threads = 1);
+
+    /**
+     * @brief Generate `count` paths as above, from a view of a cached DP,
+     * e.g. `dp::BasicCache<C>::global().paths(T, start)`, so that the table
+     * is shared with other calls from any start; the cached DPs use the moves
+     * of `dp::Lazy5`.
+     */
+    template<typename C = dp::Cnt>
+    std::vector<std::pair<dp::Loc, dp::Loc>> generate_paths(dp::Time const& T,
+        dp::BasicView<C> const& paths, std::pair<dp::Loc, dp::Loc> const& end,
+        std::size_t count, std::uint64_t seed, unsigned threads = 1);
+
+    /**
+     * @brief Generate `count` paths from `start` to `end` in `T` steps as in
+     * `generate_paths`, without ever storing the whole DP, see
+     * `dp::Checkpoints`; for paths too long for `all_paths` to fit in memory.
+     * The moves are those of the stencil S, as in `all_paths`.
+     * @param T The number of time steps in the trajectories.
+     * @param start The starting point of the paths.
+     * @param end The endpoint of the generated trajectories.
+     * @param count The number of trajectories.
+     * @param seed The seed of the random streams.
+     * @param blocked The set of blocked cells.
+     * @param spacing The distance between the stored layers, 0 to pick the
+     * one that needs the least memory.
+     * @return The trajectories one after another, so the kth item of path p
+     * is at p * (T + 1) + k; or an empty vector if the path is impossible.
+     */
+    template<typename C = dp::Cnt, typename S = dp::Lazy5>
+    std::vector<std::pair<dp::Loc, dp::Loc>> generate_paths_checkpointed(
+        dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+        std::pair<dp::Loc, dp::Loc> const& end, std::size_t count,
+        std::uint64_t seed, std::unordered_set<dp::Blocked> const& blocked = {},
+        dp::Time spacing = 0);
 }
 #endif
@@ -0,0 +1,559 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "rns.hpp"
+
+#include <array>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include "pool.hpp"
+#include "stencil_defs.hpp"
+
+namespace dp {
+    namespace {
+        /**
+         * @brief Compute a * b mod p.
+         */
+        std::uint64_t mul_mod(std::uint64_t a, std::uint64_t b,
+                std::uint64_t p) {
+            return static_cast<std::uint64_t>(static_cast<Wide>(a) * b % p);
+        }
+
+        /**
+         * Montgomery multiplication modulo an odd p < 2^62, which avoids the
+         * 128-bit division in `mul_mod`.
+         */
+        struct Montgomery {
+            /// The modulus.
+            std::uint64_t p;
+            /// -1 / p mod 2^64.
+            std::uint64_t neg_inv;
+            /// 2^128 mod p, to convert to and from Montgomery form.
+            std::uint64_t r2;
+
+            explicit Montgomery(std::uint64_t q): p{q}, neg_inv{1},
+                    r2{static_cast<std::uint64_t>(
+                        (~Wide{0} % q + 1) % q)} {
+                // Newton's iteration doubles the number of correct bits.
+                std::uint64_t inv = q;
+                for (int k = 0; k < 5; ++k)
+                    inv *= 2 - q * inv;
+                neg_inv = std::uint64_t{0} - inv;
+            }
+
+            /**
+             * @brief Compute a * b / 2^64 mod p, for a, b < p.
+             */
+            std::uint64_t reduce(std::uint64_t a, std::uint64_t b) const {
+                auto x = static_cast<Wide>(a) * b;
+                auto m = static_cast<std::uint64_t>(x) * neg_inv;
+                auto res = static_cast<std::uint64_t>((x
+                    + static_cast<Wide>(m) * p) >> 64);
+                return res - (p & (std::uint64_t{0} - (res >= p)));
+            }
+
+            /**
+             * @brief Compute a * b mod p, for a, b < p.
+             */
+            std::uint64_t mul(std::uint64_t a, std::uint64_t b) const {
+                return reduce(reduce(a, r2), b);
+            }
+        };
+
+        /**
+         * @brief Compute a^e mod p.
+         */
+        std::uint64_t pow_mod(std::uint64_t a, std::uint64_t e,
+                std::uint64_t p) {
+            std::uint64_t res = 1;
+            for (a %= p; e > 0; e >>= 1) {
+                if (e & 1)
+                    res = mul_mod(res, a, p);
+                a = mul_mod(a, a, p);
+            }
+            return res;
+        }
+
+        /**
+         * @brief Miller-Rabin test, deterministic for 64-bit numbers.
+         */
+        bool is_prime(std::uint64_t n) {
+            if (n < 2)
+                return false;
+            std::uint64_t const bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29,
+                31, 37};
+            for (auto a: bases)
+                if (n % a == 0)
+                    return n == a;
+            auto d = n - 1;
+            unsigned s = 0;
+            for (; d % 2 == 0; d /= 2)
+                ++s;
+            for (auto a: bases) {
+                auto x = pow_mod(a, d, n);
+                if (x == 1 || x == n - 1)
+                    continue;
+                bool composite = true;
+                for (unsigned r = 1; r < s && composite; ++r) {
+                    x = mul_mod(x, x, n);
+                    composite = x != n - 1;
+                }
+                if (composite)
+                    return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Compute a mod p for a prime p; an unsigned long holds 64
+         * bits, see `Count<std::uint64_t>::to_cnt`.
+         */
+        std::uint64_t mod(Cnt const& a, std::uint64_t p) {
+            return mpz_fdiv_ui(a.get_mpz_t(), p);
+        }
+
+        /**
+         * @brief Prepare the reconstruction of numbers from their residues.
+         * @param primes The primes.
+         * @param basis Filled with, per prime p, the number that is 1 modulo
+         * p and 0 modulo the others.
+         * @return The product of the primes.
+         */
+        Cnt crt_basis(std::vector<std::uint64_t> const& primes,
+                std::vector<Cnt>& basis) {
+            Cnt modulus = 1;
+            for (auto p: primes)
+                modulus *= to_cnt(p);
+            basis.clear();
+            for (auto p: primes) {
+                Cnt rest = modulus / to_cnt(p);
+                auto inv = pow_mod(mod(rest, p), p - 2, p);
+                basis.push_back(rest * to_cnt(inv));
+            }
+            return modulus;
+        }
+
+        /**
+         * The number-theoretic transform of length n, a power of two up to
+         * 2^32, modulo a prime from `rns_primes`.
+         */
+        class Ntt {
+            /// The multiplication modulo the prime.
+            Montgomery m;
+            /// The length.
+            std::size_t n;
+            /// The powers w^(kn / 2l) for 0 <= k < l at l + k, for every
+            /// power of two l < n and a primitive n-th root of unity w; and
+            /// the same for 1 / w. All in Montgomery form.
+            std::vector<std::uint64_t> forward, inverse;
+            /// The bit reversal of every index.
+            std::vector<std::size_t> rev;
+
+        public:
+            /**
+             * @brief Find a root of unity and tabulate its powers.
+             * @param p The prime.
+             * @param size The length n, at least 2.
+             */
+            Ntt(std::uint64_t p, std::size_t size): m{p}, n{size},
+                    forward(n), inverse(n), rev(n, 0) {
+                std::uint64_t w = 1;
+                for (std::uint64_t a = 2; ; ++a) {
+                    w = pow_mod(a, (p - 1) / n, p);
+                    if (pow_mod(w, n / 2, p) == p - 1)
+                        break;
+                }
+                auto wi = pow_mod(w, p - 2, p);
+                for (std::size_t l = 1; l < n; l <<= 1) {
+                    auto x = pow_mod(w, n / (2 * l), p);
+                    auto y = pow_mod(wi, n / (2 * l), p);
+                    std::uint64_t a = 1, b = 1;
+                    for (std::size_t k = 0; k < l; ++k) {
+                        forward[l + k] = m.reduce(a, m.r2);
+                        inverse[l + k] = m.reduce(b, m.r2);
+                        a = mul_mod(a, x, p);
+                        b = mul_mod(b, y, p);
+                    }
+                }
+                for (std::size_t k = 1; k < n; ++k)
+                    rev[k] = (rev[k >> 1] >> 1) | (k & 1 ? n >> 1 : 0);
+            }
+
+            /**
+             * @brief The multiplication modulo the prime.
+             */
+            Montgomery const& mont() const {
+                return m;
+            }
+
+            /**
+             * @brief w^k in Montgomery form, for 0 <= k < n.
+             */
+            std::uint64_t root(std::size_t k) const {
+                return k < n / 2 ? forward[n / 2 + k] : m.p - forward[k];
+            }
+
+            /**
+             * @brief The index k with its bits reversed.
+             */
+            std::size_t reverse(std::size_t k) const {
+                return rev[k];
+            }
+
+            /**
+             * @brief Replace a[k] by the sum of a[l] w^(kl), or w^(-kl) for
+             * the inverse, without dividing by n; the input must be in the
+             * order of `reverse`, the output is in the natural order.
+             */
+            void run(std::uint64_t* a, bool inv) const {
+                auto const& w = inv ? inverse : forward;
+                auto const p = m.p;
+                for (std::size_t len = 1; len < n; len <<= 1) {
+                    for (std::size_t i = 0; i < n; i += 2 * len) {
+                        for (std::size_t k = 0; k < len; ++k) {
+                            auto u = a[i + k];
+                            auto v = m.reduce(a[i + k + len], w[len + k]);
+                            a[i + k] = add_mod(u, v, p);
+                            a[i + k + len] = add_mod(u, p - v, p);
+                        }
+                    }
+                }
+            }
+        };
+    }
+
+    std::vector<std::uint64_t> rns_primes(std::size_t count) {
+        std::vector<std::uint64_t> res;
+        auto c = (std::uint64_t{1} << 30) - 1;
+        for (; res.size() < count && c > 0; --c) {
+            auto p = (c << 32) + 1;
+            if (is_prime(p))
+                res.push_back(p);
+        }
+        if (res.size() < count)
+            throw std::length_error("Not enough primes.");
+        return res;
+    }
+
+    std::size_t rns_count(Cnt const& bound) {
+        // All primes exceed 2^61, so k of them have a product above 2^(61k).
+        return mpz_sizeinbase(bound.get_mpz_t(), 2) / 61 + 1;
+    }
+
+    void RnsDP::fill(std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells,
+            unsigned weight, std::function<void(Time const&,
+            std::uint64_t const*, std::uint64_t*, std::uint64_t const&)> const&
+            step) {
+        if (T > std::numeric_limits<Loc>::max())
+            throw std::length_error("Please pick a lower value of T.");
+
+        blocked = Obstacles(T, blocked_cells, origin);
+        if (layout.folded() && !blocked.symmetric())
+            throw std::invalid_argument("Obstacles are not symmetric.");
+
+        // Sums over time in `flatten` are the largest numbers we reconstruct.
+        primes = rns_primes(rns_count(path_bound(T, weight) * (T + 1)));
+        modulus = crt_basis(primes, basis);
+
+        auto size = layout.size();
+        residues.assign(primes.size() * size, 0);
+        if (!blocked.blocked(0, 0, 0))
+            for (std::size_t k = 0; k < primes.size(); ++k)
+                residues[k * size + layout.offset(0, 0, 0)] = 1;
+
+        for (std::size_t k = 0; k < primes.size(); ++k) {
+            auto* table = residues.data() + k * size;
+            for (Time t = 0; t < T; ++t) {
+                step(t, table + layout.layer_begin(t),
+                    table + layout.layer_begin(t + 1), primes[k]);
+                blocked.clear(layout, t + 1, layout.first_row(t + 1),
+                    layout.last_row(t + 1), table + layout.layer_begin(t + 1));
+            }
+        }
+
+        set_shift(std::move(origin));
+    }
+
+    RnsDP::RnsDP(RnsDP const& other, Layout cells): T{other.T},
+            layout{std::move(cells)}, primes{other.primes},
+            modulus{other.modulus}, basis{other.basis},
+            residues(primes.size() * layout.size()), blocked{other.blocked},
+            flip{other.flip}, f{other.f}, shift{other.shift} {
+        // Intentionally left blank.
+    }
+
+    std::size_t RnsDP::index(Loc const& i, Loc const& j, Time const& t) const {
+        if (t > T)
+            return Layout::npos;
+        auto [si, sj] = shift;
+        Loc is = f * (i - si), js = f * (j - sj);
+        auto tf = flip ? T - t : t;
+        auto offset = layout.offset(is, js, tf);
+        if (offset == Layout::npos)
+            return Layout::npos;
+        if (blocked.blocked(is, js, tf))
+            return Layout::npos;
+        return layout.layer_begin(tf) + offset;
+    }
+
+    Cnt RnsDP::crt(std::uint64_t const* r, std::size_t stride) const {
+        Cnt res = 0;
+        for (std::size_t k = 0; k < primes.size(); ++k)
+            res += basis[k] * to_cnt(r[k * stride]);
+        return res % modulus;
+    }
+
+    std::size_t RnsDP::moduli() const {
+        return primes.size();
+    }
+
+    Cnt RnsDP::at(Loc const& i, Loc const& j, Time const& t) const {
+        if (t > T)
+            throw std::invalid_argument("t is larger than T");
+        auto idx = index(i, j, t);
+        return idx == Layout::npos ? Cnt{0}
+            : crt(residues.data() + idx, layout.size());
+    }
+
+    void RnsDP::flip_time() {
+        flip = !flip;
+    }
+
+    void RnsDP::flip_coords() {
+        f *= -1;
+    }
+
+    void RnsDP::set_shift(std::pair<Loc, Loc> origin) {
+        auto [i, j] = origin;
+        auto l = std::numeric_limits<Loc>::min() + static_cast<Loc>(T);
+        auto u = std::numeric_limits<Loc>::max() - static_cast<Loc>(T);
+        if (i <= l || j <= l || i >= u || j >= u)
+            throw std::out_of_range("Please shift less.");
+
+        shift = std::move(origin);
+    }
+
+    RnsDP RnsDP::operator*(RnsDP const& other) const {
+        if (flip == other.flip || T != other.T || primes != other.primes)
+            throw std::invalid_argument("These DPs cannot be combined.");
+
+        RnsDP res(*this, layout.folded() ? Layout::diamond(T,
+            layout.diagonal()) : layout);
+        auto const& cells = res.layout;
+        auto size = cells.size();
+        std::vector<Montgomery> mont(primes.begin(), primes.end());
+        // Per layer, find the matching cells once and then run over all the
+        // primes.
+        std::vector<std::array<std::size_t, 3>> match;
+        auto [xs, ys] = shift;
+        for (Time t = 0; t <= T; ++t) {
+            auto tf = flip ? T - t : t;
+            match.clear();
+            for (Loc is = cells.first_row(tf); is <= cells.last_row(tf);
+                    ++is) {
+                auto const& span = cells.row(is, tf);
+                for (Loc js = span.lo; js <= span.hi; ++js) {
+                    Loc i = xs + f * is, j = ys + f * js;
+                    auto a = index(i, j, t), b = other.index(i, j, t);
+                    if (a != Layout::npos && b != Layout::npos)
+                        match.push_back({cells.layer_begin(tf) + span.offset
+                            + static_cast<std::size_t>(js - span.lo), a, b});
+                }
+            }
+            for (std::size_t k = 0; k < primes.size(); ++k) {
+                auto* r = res.residues.data() + k * size;
+                auto const* x = residues.data() + k * layout.size();
+                auto const* y = other.residues.data()
+                    + k * other.layout.size();
+                for (auto const& [c, a, b]: match)
+                    r[c] = mont[k].mul(x[a], y[b]);
+            }
+        }
+        return res;
+    }
+
+    Grid RnsDP::flatten(Time const& max_time) const {
+        // Sum up the residues in a square around the shift, then reconstruct
+        // every cell once.
+        auto sT = static_cast<Loc>(T);
+        auto side = static_cast<std::size_t>(2 * sT + 1);
+        auto area = side * side;
+        std::vector<std::uint64_t> sums(primes.size() * area, 0);
+        auto const cells = layout.folded() ? Layout::diamond(T,
+            layout.diagonal()) : layout;
+        auto [xs, ys] = shift;
+        auto tmax = max_time < T ? max_time : T;
+        std::vector<std::pair<std::size_t, std::size_t>> match;
+        for (Time t = 0; t <= tmax; ++t) {
+            auto tf = flip ? T - t : t;
+            match.clear();
+            for (Loc is = cells.first_row(tf); is <= cells.last_row(tf);
+                    ++is) {
+                auto const& span = cells.row(is, tf);
+                for (Loc js = span.lo; js <= span.hi; ++js) {
+                    auto idx = index(xs + f * is, ys + f * js, t);
+                    if (idx != Layout::npos)
+                        match.emplace_back(static_cast<std::size_t>(is + sT)
+                            * side + static_cast<std::size_t>(js + sT), idx);
+                }
+            }
+            for (std::size_t k = 0; k < primes.size(); ++k) {
+                auto* s = sums.data() + k * area;
+                auto const* r = residues.data() + k * layout.size();
+                for (auto const& [c, idx]: match)
+                    s[c] = add_mod(s[c], r[idx], primes[k]);
+            }
+        }
+
+        Grid res(sT, shift);
+        for (Loc is = -sT; is <= sT; ++is) {
+            for (Loc js = -sT; js <= sT; ++js) {
+                auto c = static_cast<std::size_t>(is + sT) * side
+                    + static_cast<std::size_t>(js + sT);
+                res.at(xs + f * is, ys + f * js) = crt(sums.data() + c, area);
+            }
+        }
+        return res;
+    }
+
+    Grid rns_layer(Time T, std::pair<Loc, Loc> origin, unsigned threads) {
+        if (T > std::numeric_limits<Loc>::max() / 2)
+            throw std::length_error("Please pick a lower value of T.");
+        auto sT = static_cast<Loc>(T);
+        // The cyclic transform of length n works with the Laurent
+        // polynomial (1 + x + 1/x + y + 1/y)^T modulo x^n - 1 and y^n - 1,
+        // i.e. with every exponent e taken modulo n. The exponents run from
+        // -T to T in both dimensions, and with n >= 2T + 1 no two of them
+        // meet: x^e lands at e for e >= 0 and at n + e for e < 0.
+        std::size_t n = 2;
+        while (n < 2 * std::size_t{T} + 1)
+            n <<= 1;
+        auto primes = rns_primes(rns_count(path_bound(T)));
+        std::vector<Cnt> basis;
+        auto modulus = crt_basis(primes, basis);
+
+        // The residues of the octant 0 <= j <= i, row by row.
+        auto cells = (std::size_t{T} + 1) * (std::size_t{T} + 2) / 2;
+        std::vector<std::uint64_t> residues(primes.size() * cells);
+        std::vector<std::uint64_t> grid(n * n);
+        std::vector<std::uint64_t> powers((n / 2 + 1) * (n / 2 + 2) / 2);
+        Pool pool(threads);
+        auto rows = [&](std::size_t count, auto const& f) {
+            pool.run([&](unsigned w) {
+                    for (auto u = count * w / pool.size();
+                            u < count * (w + 1) / pool.size(); ++u)
+                        f(u);
+                });
+        };
+        // Where the transform of row u, or column u, is the same as for
+        // some u <= n / 2.
+        auto fold = [n](std::size_t u) {
+            return u <= n / 2 ? u : n - u;
+        };
+        for (std::size_t k = 0; k < primes.size(); ++k) {
+            auto const p = primes[k];
+            Ntt ntt(p, n);
+            auto const& m = ntt.mont();
+            // 1 / n^2; a reduction with it also leaves Montgomery form.
+            auto scale = pow_mod(mul_mod(n % p, n % p, p), p - 2, p);
+            auto one = m.reduce(1, m.r2);
+            // w^u + w^-u, in Montgomery form.
+            std::vector<std::uint64_t> c(n / 2 + 1);
+            for (std::size_t u = 0; u <= n / 2; ++u)
+                c[u] = add_mod(ntt.root(u), ntt.root((n - u) % n), p);
+
+            // The transform of 1 + x + 1/x + y + 1/y is its value at
+            // (w^u, w^v), 1 + c[u] + c[v], which is raised to the power T
+            // right away. It does not change when u and v are swapped or
+            // negated, so only the octant v <= u <= n / 2 is computed.
+            rows(n / 2 + 1, [&](std::size_t u) {
+                    for (std::size_t v = 0; v <= u; ++v) {
+                        auto q = add_mod(add_mod(one, c[u], p), c[v], p);
+                        auto r = one;
+                        for (auto e = T; e > 0; e >>= 1) {
+                            if (e & 1)
+                                r = m.reduce(r, q);
+                            q = m.reduce(q, q);
+                        }
+                        powers[u * (u + 1) / 2 + v] = m.reduce(r, scale);
+                    }
+                });
+            rows(n, [&](std::size_t u) {
+                    auto a = fold(ntt.reverse(u));
+                    for (std::size_t v = 0; v < n; ++v) {
+                        auto b = fold(ntt.reverse(v));
+                        grid[u * n + v] = powers[a > b ? a * (a + 1) / 2 + b
+                            : b * (b + 1) / 2 + a];
+                    }
+                });
+            rows(n, [&](std::size_t u) {
+                    ntt.run(grid.data() + u * n, true);
+                });
+            rows(n, [&](std::size_t u) {
+                    for (std::size_t v = u + 1; v < n; ++v)
+                        std::swap(grid[u * n + v], grid[v * n + u]);
+                });
+            rows(n, [&](std::size_t u) {
+                    ntt.run(grid.data() + u * n, true);
+                });
+
+            // Now the coefficient of x^i y^j is at j * n + i, modulo n.
+            auto* r = residues.data() + k * cells;
+            for (Loc i = 0; i <= sT; ++i)
+                for (Loc j = 0; j <= i; ++j)
+                    *r++ = grid[static_cast<std::size_t>(j) * n
+                        + static_cast<std::size_t>(i)];
+        }
+
+        Grid res(sT, origin);
+        auto [si, sj] = origin;
+        pool.run([&](unsigned w) {
+                auto c = cells * w / pool.size();
+                auto end = cells * (w + 1) / pool.size();
+                // Row i of the octant starts at cell i (i + 1) / 2.
+                Loc i = 0;
+                std::size_t row = 0;
+                for (; row + static_cast<std::size_t>(i) + 1 <= c; ++i)
+                    row += static_cast<std::size_t>(i) + 1;
+                auto j = static_cast<Loc>(c - row);
+                for (; c < end; ++c) {
+                    Cnt v = 0;
+                    for (std::size_t k = 0; k < primes.size(); ++k)
+                        v += basis[k] * to_cnt(residues[k * cells + c]);
+                    v %= modulus;
+                    for (auto [a, b]: {std::pair<Loc, Loc>{i, j}, {j, i}})
+                        for (Loc fa: {-1, 1})
+                            for (Loc fb: {-1, 1})
+                                res.at(si + fa * a, sj + fb * b) = v;
+                    if (++j > i) {
+                        ++i;
+                        j = 0;
+                    }
+                }
+            });
+        return res;
+    }
+
+// The constructor for every compiled stencil.
+#define RNS_STENCIL(S) \
+    template RnsDP::RnsDP(Time, S, std::pair<Loc, Loc>, \
+        std::unordered_set<Blocked> const&, Storage);
+
+    RNS_STENCIL(Walk4)
+    RNS_STENCIL(Lazy5)
+    RNS_STENCIL(King8)
+    RNS_STENCIL(Lazy9)
+
+#undef RNS_STENCIL
+}
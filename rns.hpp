@@ -0,0 +1,225 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RNS_H
+#define RNS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "dp.hpp"
+#include "layout.hpp"
+#include "obstacles.hpp"
+#include "stencil.hpp"
+
+namespace dp {
+    /**
+     * @brief The largest primes below 2^62 of the form c * 2^32 + 1, in
+     * decreasing order.
+     * @param count The number of primes.
+     * @return The primes.
+     */
+    std::vector<std::uint64_t> rns_primes(std::size_t count);
+
+    /**
+     * @brief The number of primes from `rns_primes` whose product exceeds
+     * `bound`, so that numbers up to `bound` are determined by their
+     * residues.
+     */
+    std::size_t rns_count(Cnt const& bound);
+
+    /**
+     * @brief Compute a + b mod p without branches, for a, b < p < 2^62;
+     * only uses operations that SSE2 has for 64-bit lanes.
+     */
+    inline std::uint64_t add_mod(std::uint64_t a, std::uint64_t b,
+            std::uint64_t p) {
+        // The top bit is set iff a + b - p is negative.
+        auto s = a + b - p;
+        return s + (p & (std::uint64_t{0} - (s >> 63)));
+    }
+
+    /**
+     * The arithmetic of the stencil functions on residues modulo a prime p
+     * from `rns_primes`, see `CountAdd`.
+     */
+    struct ResidueAdd {
+        std::uint64_t p;
+
+        void operator()(std::uint64_t& a, std::uint64_t const& b) const {
+            a = add_mod(a, b, p);
+        }
+
+        void operator()(std::uint64_t& a, std::uint64_t const& b,
+                unsigned const& w) const {
+            a = add_mod(a, static_cast<std::uint64_t>(static_cast<Wide>(b) * w
+                % p), p);
+        }
+    };
+
+    /**
+     * The same dynamic program as `DP`, computed modulo several 62-bit primes
+     * instead of with GMP; the exact counts are reconstructed with the Chinese
+     * remainder theorem only when they are read.
+     *
+     * The residues for every prime are a flat array in the layout of the
+     * table, and propagation adds them with a branch-free modular addition
+     * that the compiler can vectorise. There are enough primes for any count
+     * in the table, for products of tables with opposite time flips (at most
+     * 5^T, like the counts), and for their sums over time in `flatten`.
+     */
+    class RnsDP {
+        /// The maximum number of steps from (0, 0).
+        Time const T;
+        /// Which cells of every layer are stored.
+        Layout layout;
+        /// The primes.
+        std::vector<std::uint64_t> primes;
+        /// The product of the primes.
+        Cnt modulus;
+        /// Per prime p, the number that is 1 modulo p and 0 modulo the others.
+        std::vector<Cnt> basis;
+        /// The residues; those for prime k start at k * layout.size().
+        std::vector<std::uint64_t> residues;
+        /// The times at which the cells get blocked.
+        Obstacles blocked;
+        /// Whether we have flipped time.
+        bool flip{false};
+        /// The factor in computing locations, -1 or 1, to flip directions.
+        Loc f{1};
+        /// The shift, i.e. starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift{0, 0};
+
+        /**
+         * @brief Copy everything but the residues, which are all 0 in a new
+         * layout.
+         * @param other The DP to copy from.
+         * @param cells The layout of the copy.
+         */
+        RnsDP(RnsDP const& other, Layout cells);
+
+        /**
+         * @brief Compute the index of a cell among the residues of the first
+         * prime, with shift and time flip.
+         * @param i First dimension.
+         * @param j Second dimension.
+         * @param t Current time.
+         * @return The index, or `Layout::npos` if the cell is not stored or
+         * is blocked at this time.
+         */
+        std::size_t index(Loc const& i, Loc const& j, Time const& t) const;
+
+        /**
+         * @brief Reconstruct a number from its residues.
+         * @param r The residue for the first prime.
+         * @param stride The distance between the residues for two primes.
+         * @return The number modulo the product of the primes.
+         */
+        Cnt crt(std::uint64_t const* r, std::size_t stride) const;
+
+        /**
+         * @brief Set up the primes and the obstacles, and compute all layers,
+         * see the constructor.
+         * @param origin The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param weight The number of paths of one step, which bounds the
+         * counts, see `stencil_weight`.
+         * @param step Computes the layer after the given one modulo a prime,
+         * from and into the residues of that prime, without the obstacles.
+         */
+        void fill(std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells,
+            unsigned weight, std::function<void(Time const&,
+            std::uint64_t const*, std::uint64_t*, std::uint64_t const&)> const&
+            step);
+
+    public:
+        /**
+         * @brief Compute the number of paths in W_{x, y, t} for all possible
+         * (x, y) and all t <= T, as in `DP`.
+         * @param max_time The value of T (allowed number of steps).
+         * @param stencil The stencil, e.g. `Lazy5{}`.
+         * @param origin The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param storage Which cells to store, see `DP::DP`.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        RnsDP(Time max_time, S stencil, std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            Storage storage = Storage::diamond);
+
+        /**
+         * @brief The number of primes used.
+         */
+        std::size_t moduli() const;
+
+        /**
+         * @brief Return the value P(i, j, t) in the DP, with 0 for unreachable
+         * cells, see `DP::at`.
+         */
+        Cnt at(Loc const& i, Loc const& j, Time const& t) const;
+
+        /**
+         * @brief Flip the time, see `DP::flip_time`.
+         */
+        void flip_time();
+
+        /**
+         * @brief Flip the coordinates, see `DP::flip_coords`.
+         */
+        void flip_coords();
+
+        /**
+         * @brief Shift the origin, see `DP::set_shift`.
+         */
+        void set_shift(std::pair<Loc, Loc> origin);
+
+        /**
+         * @brief Combine two DPs by multiplying matching entries, see
+         * `DP::operator*`; the residues are multiplied prime by prime.
+         * @param other The second DP, with the same `T` and opposite `flip`.
+         * @return The multiplied DP, with the shift and flip of this one.
+         */
+        RnsDP operator*(RnsDP const& other) const;
+
+        /**
+         * @brief Flatten a DP to sum up the values at the same time stamp, see
+         * `DP::flatten`; the sums are taken on the residues.
+         */
+        Grid flatten(Time const& max_time) const;
+    };
+
+    /**
+     * @brief Layer T of the paths from `origin` without obstacles, as
+     * `DP(T, Lazy5{}, origin).layer(T)`, without the layers before it.
+     *
+     * The layer holds the coefficients of (1 + x + 1/x + y + 1/y)^T. Modulo
+     * every prime of `rns_primes`, this polynomial is evaluated at the
+     * roots of unity, raised to the power T pointwise and brought back with
+     * an inverse two-dimensional number-theoretic transform: O(T^2 log T)
+     * operations per prime instead of the O(T^3) of the DP. The counts are
+     * then reconstructed for one octant, as the layer is symmetric.
+     * @param T The number of steps.
+     * @param origin The starting point of the paths.
+     * @param threads The number of threads, see `Pool`.
+     * @return The counts within T steps of origin, accessible with at(i, j).
+     */
+    Grid rns_layer(Time T, std::pair<Loc, Loc> origin = {0, 0},
+        unsigned threads = 1);
+}
+#endif
@@ -0,0 +1,30 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "sampler.hpp"
+
+#include "stencil_defs.hpp"
+
+namespace dp {
+// The samplers for every compiled stencil.
+#define SAMPLER_COUNT(C) \
+    template class BasicSampler<C, Walk4>; \
+    template class BasicSampler<C, Lazy5>; \
+    template class BasicSampler<C, King8>; \
+    template class BasicSampler<C, Lazy9>;
+
+    SAMPLER_COUNT(std::uint64_t)
+    SAMPLER_COUNT(Wide)
+    SAMPLER_COUNT(Cnt)
+
+#undef SAMPLER_COUNT
+}
@@ -0,0 +1,168 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "dp.hpp"
+#include "layout.hpp"
+#include "stencil.hpp"
+
+namespace dp {
+    /**
+     * A sampler of random paths to a fixed end point, compiled from a DP of
+     * all paths with the moves of the stencil S: for every cell that a path
+     * can pass through on the way back from the end, the probabilities of the
+     * steps back, one per move, are stored as 32-bit fixed-point cut points,
+     * so every step of a path takes one random word and a few comparisons
+     * instead of reading and drawing big numbers.
+     *
+     * A draw that falls on a rounded cut point is ambiguous. In exact mode,
+     * it is resolved with more random bits against the counts of the DP, so
+     * every path is drawn with the same probability as in `generate_path`;
+     * otherwise, the lower possible step is taken, which is off by at most
+     * 2^-32 per step.
+     */
+    template<typename C, typename S = Lazy5>
+    class BasicSampler {
+        static_assert(is_stencil_v<S>, "S should be a stencil.");
+
+        /// The number of moves, and so of steps back from every cell.
+        static constexpr std::size_t N = S::moves.size();
+
+        /// The cut points of one cell.
+        struct Cuts {
+            /// Per step, floor(2^32 * (the count up to that step) / total),
+            /// at most 2^32 - 1; the last step has no cut point.
+            std::array<std::uint32_t, N - 1> cut;
+            /// Bit k is set iff step k has a non-zero count.
+            std::uint32_t live;
+        };
+
+        /// The DP of all paths, for the exact mode.
+        BasicDP<C> const* paths;
+        /// The number of steps T.
+        Time T;
+        /// The end point.
+        std::pair<Loc, Loc> end;
+        /// Whether to resolve ambiguous draws exactly.
+        bool exact;
+        /// The cells within s steps of the end in layer s, for 0 <= s < T.
+        Layout layout;
+        /// The cut points of the cells at time T - s in layer s.
+        std::vector<Cuts> table;
+
+        /**
+         * @brief The counts of the steps back from (i, j) at time t, in the
+         * order of the moves as in `stencil_back`: the count of the cell that
+         * the move comes from, times its weight.
+         */
+        std::array<Cnt, N> counts(Loc const& i, Loc const& j,
+            Time const& t) const;
+
+        /**
+         * @brief Resolve an ambiguous draw exactly by drawing more bits of the
+         * uniform number that starts with u.
+         * @param i First dimension of the cell.
+         * @param j Second dimension of the cell.
+         * @param t The time of the cell.
+         * @param u The first 32 bits.
+         * @param gen The generator of uniform 64-bit words.
+         * @return The step, 0 to N - 1.
+         */
+        template<typename Gen>
+        std::size_t refine(Loc const& i, Loc const& j, Time const& t,
+                std::uint32_t u, Gen& gen) const {
+            auto c = counts(i, j, t);
+            std::array<Cnt, N> sums;
+            Cnt total = 0;
+            for (std::size_t k = 0; k < N; ++k) {
+                total += c[k];
+                sums[k] = total;
+            }
+            // The uniform number lies in [x, x + 1) / 2^n.
+            Cnt x = u;
+            std::size_t n = 32;
+            while (true) {
+                std::size_t lo = 0, hi = 0;
+                Cnt a = x * total, b = (x + 1) * total;
+                while (lo < N - 1 && (sums[lo] << n) <= a)
+                    ++lo;
+                while (hi < N - 1 && (sums[hi] << n) < b)
+                    ++hi;
+                if (lo == hi)
+                    return lo;
+                x <<= 64;
+                x += Count<std::uint64_t>::to_cnt(gen());
+                n += 64;
+            }
+        }
+
+    public:
+        /**
+         * @brief Compile the sampler.
+         * @param max_time The number of steps T.
+         * @param all The DP of all paths from the start, with at least T
+         * steps, computed with the stencil S; it must outlive the sampler in
+         * exact mode.
+         * @param finish The end point, reachable in T steps; throw an
+         * exception if it is not, or if a cell on the way back has no cell to
+         * come from, as for a DP computed with another stencil.
+         * @param exact_mode Whether to resolve ambiguous draws exactly.
+         * @param threads The number of threads for compiling, see `Pool`.
+         */
+        BasicSampler(Time max_time, BasicDP<C> const& all,
+            std::pair<Loc, Loc> finish, bool exact_mode = true,
+            unsigned threads = 1);
+
+        /**
+         * @brief Draw a path.
+         * @param gen The generator of uniform 64-bit words.
+         * @param out Where to write the T + 1 points of the path, by time.
+         */
+        template<typename Gen>
+        void sample(Gen& gen, std::pair<Loc, Loc>* out) const {
+            auto [ci, cj] = end;
+            auto [ei, ej] = end;
+            for (Time s = 0; s < T; ++s) {
+                auto t = T - s;
+                out[t] = {ci, cj};
+                auto const& cell = table[layout.layer_begin(s)
+                    + layout.offset(ci - ei, cj - ej, s)];
+                auto u = static_cast<std::uint32_t>(gen() >> 32);
+                std::size_t k = 0;
+                while (k < N - 1 && u > cell.cut[k])
+                    ++k;
+                if (k < N - 1 && u == cell.cut[k]) {
+                    if (exact)
+                        k = refine(ci, cj, t, u, gen);
+                    else
+                        while (!(cell.live >> k & 1))
+                            ++k;
+                }
+                ci -= S::moves[k].di;
+                cj -= S::moves[k].dj;
+            }
+            out[0] = {ci, cj};
+        }
+    };
+
+    using Sampler = BasicSampler<Cnt>;
+}
+#endif
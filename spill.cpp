@@ -0,0 +1,191 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "spill.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <stdexcept>
+#include <unistd.h>
+#include "stencil_defs.hpp"
+
+namespace dp {
+    template<typename C>
+    void BasicSpill<C>::fill(std::string const& dir,
+            std::unordered_set<Blocked> const& blocked_cells,
+            std::function<void(Time const&, C const*, C*)> const& step) {
+        if (capacity < 1)
+            throw std::invalid_argument("Please cache at least one layer.");
+        Obstacles blocked(T, blocked_cells, shift);
+        if (layout.folded() && !blocked.symmetric())
+            throw std::invalid_argument("Obstacles are not symmetric.");
+
+        auto path = dir + "/spill-XXXXXX";
+        std::vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        fd = ::mkstemp(name.data());
+        if (fd < 0)
+            throw std::runtime_error("Could not create a file in " + dir + ".");
+        ::unlink(name.data());
+
+        try {
+            begin.push_back(0);
+            std::vector<C> prev(layout.layer_size(T)), next(prev.size());
+            if (!blocked.blocked(0, 0, 0))
+                prev[layout.offset(0, 0, 0)] = 1;
+            for (Time t = 0; ; ++t) {
+                append(t, prev.data());
+                if (t == T)
+                    break;
+                for (std::size_t k = 0; k < layout.layer_size(t + 1); ++k)
+                    next[k] = 0;
+                step(t, prev.data(), next.data());
+                blocked.clear(layout, t + 1, layout.first_row(t + 1),
+                    layout.last_row(t + 1), next.data());
+                std::swap(prev, next);
+            }
+            // The last layer is still at hand for a pass back in time.
+            insert(T, std::move(prev));
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    template<typename C>
+    BasicSpill<C>::~BasicSpill() {
+        if (pending.valid())
+            pending.wait();
+        ::close(fd);
+    }
+
+    template<typename C>
+    void BasicSpill<C>::append(Time const& t, C const* cells) {
+        auto n = layout.layer_size(t);
+        std::size_t width = 1;
+        for (std::size_t k = 0; k < n; ++k)
+            width = std::max(width, Count<C>::words(cells[k]));
+
+        std::vector<std::uint64_t> out(1 + n * width);
+        out[0] = width;
+        for (std::size_t k = 0; k < n; ++k)
+            Count<C>::put(cells[k], out.data() + 1 + k * width, width);
+
+        auto const* data = reinterpret_cast<char const*>(out.data());
+        auto left = out.size() * sizeof(std::uint64_t);
+        while (left > 0) {
+            auto done = ::write(fd, data, left);
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done < 0)
+                throw std::runtime_error("Could not write a layer to disk.");
+            data += done;
+            left -= static_cast<std::size_t>(done);
+        }
+        begin.push_back(begin.back() + out.size() * sizeof(std::uint64_t));
+    }
+
+    template<typename C>
+    std::vector<C> BasicSpill<C>::read(Time const& t) const {
+        std::vector<std::uint64_t> in((begin[t + 1] - begin[t])
+            / sizeof(std::uint64_t));
+        auto* data = reinterpret_cast<char*>(in.data());
+        auto at = begin[t];
+        auto left = in.size() * sizeof(std::uint64_t);
+        while (left > 0) {
+            auto done = ::pread(fd, data, left, static_cast<off_t>(at));
+            if (done < 0 && errno == EINTR)
+                continue;
+            if (done <= 0)
+                throw std::runtime_error("Could not read a layer from disk.");
+            data += done;
+            at += static_cast<std::uint64_t>(done);
+            left -= static_cast<std::size_t>(done);
+        }
+
+        std::size_t width = in[0];
+        std::vector<C> cells(layout.layer_size(t));
+        for (std::size_t k = 0; k < cells.size(); ++k)
+            Count<C>::get(cells[k], in.data() + 1 + k * width, width);
+        return cells;
+    }
+
+    template<typename C>
+    void BasicSpill<C>::insert(Time const& t, std::vector<C> cells) {
+        cached.emplace_front(t, std::move(cells));
+        while (cached.size() > capacity)
+            cached.pop_back();
+    }
+
+    template<typename C>
+    Time BasicSpill<C>::max_time() const {
+        return T;
+    }
+
+    template<typename C>
+    std::size_t BasicSpill<C>::bytes() const {
+        return begin.back();
+    }
+
+    template<typename C>
+    void BasicSpill<C>::prefetch(Time const& t) {
+        if (t > T)
+            throw std::out_of_range("The layer is beyond T.");
+        if (ahead == t || std::any_of(cached.begin(), cached.end(),
+                [&t](auto const& entry) { return entry.first == t; }))
+            return;
+        if (ahead <= T) {
+            auto s = ahead;
+            ahead = T + 1;
+            insert(s, pending.get());
+        }
+        ahead = t;
+        pending = std::async(std::launch::async, [this, t] {
+                return read(t);
+            });
+    }
+
+    template<typename C>
+    BasicLayer<C> BasicSpill<C>::layer(Time const& t) {
+        if (t > T)
+            throw std::out_of_range("The layer is beyond T.");
+        auto it = std::find_if(cached.begin(), cached.end(),
+            [&t](auto const& entry) { return entry.first == t; });
+        if (it != cached.end()) {
+            cached.splice(cached.begin(), cached, it);
+        } else if (ahead == t) {
+            ahead = T + 1;
+            insert(t, pending.get());
+        } else {
+            insert(t, read(t));
+        }
+        return {layout, t, cached.front().second.data(), shift};
+    }
+
+// The constructors for every compiled stencil.
+#define SPILL_STENCIL(C, S) \
+    template BasicSpill<C>::BasicSpill(Time, S, std::string const&, \
+        std::pair<Loc, Loc>, std::unordered_set<Blocked> const&, std::size_t, \
+        Storage);
+#define SPILL_COUNT(C) \
+    template class BasicSpill<C>; \
+    SPILL_STENCIL(C, Walk4) SPILL_STENCIL(C, Lazy5) SPILL_STENCIL(C, King8) \
+    SPILL_STENCIL(C, Lazy9)
+
+    SPILL_COUNT(std::uint64_t)
+    SPILL_COUNT(Wide)
+    SPILL_COUNT(Cnt)
+
+#undef SPILL_COUNT
+#undef SPILL_STENCIL
+}
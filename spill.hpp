@@ -0,0 +1,159 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "layout.hpp"
+#include "obstacles.hpp"
+#include "stencil.hpp"
+
+namespace dp {
+    /**
+     * The same dynamic program as `DP`, computed one layer at a time as in
+     * `Sweep`, with every finished layer appended to a file instead of kept
+     * in memory: only a few layers, O(T^2) cells, are in memory at a time,
+     * and the table takes as much disk space as `DP` would take memory.
+     *
+     * The layers are read back through a small cache of the most recently
+     * used ones; `prefetch` reads a layer on another thread in the meantime,
+     * so a pass over the layers in either order mostly overlaps the reads
+     * with the work on the previous layer.
+     *
+     * Every layer is stored with as many 64-bit words per cell as its largest
+     * count needs, as in `write_table`, so large bignums only cost their size.
+     * The file is deleted as soon as it is created, so it disappears with the
+     * table, also if the program is killed.
+     */
+    template<typename C>
+    class BasicSpill {
+        /// The maximum number of steps from (0, 0).
+        Time const T;
+        /// Which cells of every layer are stored: those within reach.
+        Layout layout;
+        /// The starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift;
+        /// The file, opened for reading and writing.
+        int fd{-1};
+        /// The position of every layer in the file, and the end of the file.
+        std::vector<std::uint64_t> begin;
+        /// The number of layers to keep in the cache, at least 1.
+        std::size_t capacity;
+        /// The cached layers, the most recently used first.
+        std::list<std::pair<Time, std::vector<C>>> cached;
+        /// The layer being read by `prefetch`, or T + 1 if there is none.
+        Time ahead;
+        /// The cells of layer `ahead`, once they are read.
+        std::future<std::vector<C>> pending;
+
+        /**
+         * @brief Compute all layers and write them to a new file, see the
+         * constructor.
+         * @param dir The directory for the file.
+         * @param blocked_cells The set of blocked cells.
+         * @param step Computes the layer after the given one, from and into
+         * a buffer, without the obstacles.
+         */
+        void fill(std::string const& dir,
+            std::unordered_set<Blocked> const& blocked_cells,
+            std::function<void(Time const&, C const*, C*)> const& step);
+
+        /**
+         * @brief Append a layer to the file.
+         * @param t The time of the layer, one more than the last one written.
+         * @param cells The `layout.layer_size(t)` cells of the layer.
+         */
+        void append(Time const& t, C const* cells);
+
+        /**
+         * @brief Read a layer from the file; safe to call from another thread
+         * while the table is used otherwise.
+         * @param t The time of the layer.
+         * @return The cells of the layer.
+         */
+        std::vector<C> read(Time const& t) const;
+
+        /**
+         * @brief Put a layer first in the cache, dropping the least recently
+         * used ones beyond the capacity.
+         */
+        void insert(Time const& t, std::vector<C> cells);
+
+    public:
+        /**
+         * @brief Compute the number of paths in W_{x, y, t} for all possible
+         * (x, y) and all t <= T, spilling the layers to a file, see
+         * `Sweep::Sweep`. Throw an exception if the file cannot be created or
+         * written, e.g. if the disk is full.
+         * @param max_time The value of T (allowed number of steps).
+         * @param stencil The stencil, e.g. `Lazy5{}`.
+         * @param dir The directory for the file.
+         * @param origin The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param cache The number of layers to cache, at least 1.
+         * @param storage Which cells to store, see `DP::DP`; `Storage::octant`
+         * takes an eighth of the disk space.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        BasicSpill(Time max_time, S stencil, std::string const& dir,
+            std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            std::size_t cache = 2, Storage storage = Storage::diamond);
+
+        BasicSpill(BasicSpill const&) = delete;
+        BasicSpill& operator=(BasicSpill const&) = delete;
+
+        /**
+         * @brief Wait for the read ahead, if any, and close the file.
+         */
+        ~BasicSpill();
+
+        /**
+         * @brief The value of T.
+         */
+        Time max_time() const;
+
+        /**
+         * @brief The number of bytes in the file.
+         */
+        std::size_t bytes() const;
+
+        /**
+         * @brief Start reading a layer on another thread, unless it is cached
+         * already; a read ahead of another layer is finished first.
+         * @param t The time, between 0 and T.
+         */
+        void prefetch(Time const& t);
+
+        /**
+         * @brief A view of a layer, read from the file unless it is cached or
+         * read ahead; valid until `cache` other layers have been read.
+         * @param t The time, between 0 and T.
+         * @return The layer, accessible with at(i, j) after the shift.
+         */
+        BasicLayer<C> layer(Time const& t);
+    };
+
+    using Spill = BasicSpill<Cnt>;
+}
+#endif
@@ -0,0 +1,415 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "layout.hpp"
+#include "obstacles.hpp"
+
+namespace dp {
+    /**
+     * A single move of a walk: from (i, j) to (i + di, j + dj), in `weight`
+     * ways; a move of weight 0 is never taken.
+     */
+    struct Move {
+        Loc di, dj;
+        unsigned weight{1};
+    };
+
+    /**
+     * The simple walk: one path in each neighbouring direction, no staying.
+     */
+    struct Walk4 {
+        static constexpr std::array<Move, 4> moves{{
+            {1, 0}, {0, 1}, {-1, 0}, {0, -1}}};
+    };
+
+    /**
+     * The uniform walk of `uniform_prop` as a compile-time stencil: one path
+     * for staying in the same spot, one in each neighbouring direction.
+     */
+    struct Lazy5 {
+        static constexpr std::array<Move, 5> moves{{
+            {0, 0}, {1, 0}, {0, 1}, {-1, 0}, {0, -1}}};
+    };
+
+    /**
+     * The walk of a chess king: one path to each of the eight neighbours,
+     * diagonals included, no staying.
+     */
+    struct King8 {
+        static constexpr std::array<Move, 8> moves{{
+            {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1},
+            {1, -1}}};
+    };
+
+    /**
+     * The lazy walk of a chess king: `King8`, plus staying in the same spot.
+     */
+    struct Lazy9 {
+        static constexpr std::array<Move, 9> moves{{
+            {0, 0}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1},
+            {0, -1}, {1, -1}}};
+    };
+
+    /**
+     * A lazy walk with a weight per direction, e.g. for a drift: staying, and
+     * moving along +i, +j, -i, -j; weight 0 forbids a move. The weights
+     * multiply the counts, so they should be small. Like any stencil of your
+     * own, it needs stencil_defs.hpp to construct the DPs.
+     */
+    template<unsigned Stay, unsigned IUp, unsigned JUp, unsigned IDown,
+        unsigned JDown>
+    struct Weighted5 {
+        static constexpr std::array<Move, 5> moves{{
+            {0, 0, Stay}, {1, 0, IUp}, {0, 1, JUp}, {-1, 0, IDown},
+            {0, -1, JDown}}};
+    };
+
+    /**
+     * Whether S is a stencil, i.e. has a static list of `moves`.
+     */
+    template<typename S, typename = void>
+    struct is_stencil: std::false_type {};
+
+    template<typename S>
+    struct is_stencil<S, std::void_t<decltype(S::moves)>>: std::true_type {};
+
+    template<typename S>
+    inline constexpr bool is_stencil_v = is_stencil<S>::value;
+
+    /**
+     * The arithmetic of the stencil functions on counts, see `Count`:
+     * add(a, b) adds b to a in place, add(a, b, w) adds w times b, for the
+     * moves of weight w > 1.
+     */
+    template<typename C>
+    struct CountAdd {
+        void operator()(C& a, C const& b) const {
+            Count<C>::add(a, b);
+        }
+
+        void operator()(C& a, C const& b, unsigned const& w) const {
+            if constexpr (std::is_same_v<C, Cnt>)
+                Count<C>::add_mul(a, b, static_cast<unsigned long>(w));
+            else
+                Count<C>::add_mul(a, b, static_cast<C>(w));
+        }
+    };
+
+    /**
+     * @brief The number of paths of one step, i.e. the sum of the weights of
+     * the moves; a DP over `double` is divided by it every step.
+     */
+    template<typename S>
+    constexpr unsigned stencil_weight() {
+        unsigned res = 0;
+        for (auto const& m: S::moves)
+            res += m.weight;
+        return res;
+    }
+
+    /**
+     * @brief Whether the stencil moves diagonally, so that the cells within
+     * reach form squares rather than diamonds, see `Layout::diamond`.
+     */
+    template<typename S>
+    constexpr bool stencil_diagonal() {
+        for (auto const& m: S::moves)
+            if (m.weight > 0 && m.di != 0 && m.dj != 0)
+                return true;
+        return false;
+    }
+
+    /**
+     * @brief Whether the stencil looks the same after flipping the signs of
+     * the coordinates or swapping them, as folded layouts need.
+     */
+    template<typename S>
+    constexpr bool stencil_symmetric() {
+        auto weight = [](Loc di, Loc dj) {
+            unsigned res = 0;
+            for (auto const& m: S::moves)
+                if (m.di == di && m.dj == dj)
+                    res += m.weight;
+            return res;
+        };
+        for (auto const& m: S::moves) {
+            auto w = weight(m.di, m.dj);
+            for (auto [a, b]: {std::pair<Loc, Loc>{m.di, m.dj}, std::pair<Loc,
+                    Loc>{m.dj, m.di}})
+                if (weight(a, b) != w || weight(-a, b) != w
+                        || weight(a, -b) != w || weight(-a, -b) != w)
+                    return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Pick the cell that a path came from, one step back, at random:
+     * every move is chosen with probability proportional to its weight times
+     * the count of the cell it comes from.
+     * @param at Called as at(i, j) for the count of (i, j) one step earlier.
+     * @param i First dimension of the current cell.
+     * @param j Second dimension of the current cell.
+     * @param total The count of the current cell, positive.
+     * @param gen The generator of uniform 64-bit words.
+     * @return The previous cell.
+     */
+    template<typename S, typename C, typename At, typename Gen>
+    std::pair<Loc, Loc> stencil_back(At const& at, Loc const& i, Loc const& j,
+            C const& total, Gen& gen) {
+        static_assert(is_stencil_v<S>, "S should be a stencil.");
+        C rchoice = Count<C>::draw(total, gen);
+        Move last{0, 0};
+        for (auto const& m: S::moves) {
+            if (m.weight == 0)
+                continue;
+            last = m;
+            C c = at(i - m.di, j - m.dj);
+            if (m.weight != 1)
+                c *= m.weight;
+            if (rchoice < c)
+                break;
+            rchoice -= c;
+        }
+        return {i - last.di, j - last.dj};
+    }
+
+    /**
+     * @brief Compute the cells (i, lo) to (i, hi) of layer t + 1 of a table
+     * from layer t by adding, for every move of the stencil, the value of the
+     * cell it comes from.
+     *
+     * Every move is applied to the whole range at once: the range of columns
+     * in which both the source and the target are stored is computed up
+     * front, so the inner loop runs over two contiguous arrays without any
+     * checks; a move of weight w adds w times the value in one go. For
+     * folded layouts, the few cells next to the mirror lines also get the
+     * contributions from outside of the octant. Moves must not change a
+     * coordinate by more than one.
+     * @param layout The layout of the table.
+     * @param t The layer to propagate from.
+     * @param i The row, stored in layer t + 1.
+     * @param lo The first column, at least that of the row.
+     * @param hi The last column, at most that of the row.
+     * @param prev The first cell of layer t.
+     * @param next The first cell of layer t + 1, zero in these cells.
+     * @param add Called as add(a, b) to add b to a in place, and as
+     * add(a, b, w) to add w times b, see `CountAdd`.
+     */
+    template<typename S, typename C, typename Add>
+    void stencil_cells(Layout const& layout, Time const& t, Loc const& i,
+            Loc const& lo, Loc const& hi, C const* prev, C* next,
+            Add const& add) {
+        static_assert(is_stencil_v<S>, "S should be a stencil.");
+        auto const& to = layout.row(i, t + 1);
+        for (auto const& m: S::moves) {
+            auto si = i - m.di;
+            if (m.weight == 0 || si < layout.first_row(t)
+                    || si > layout.last_row(t))
+                continue;
+            auto const& from = layout.row(si, t);
+            auto a = std::max(lo, from.lo + m.dj);
+            auto b = std::min(hi, from.hi + m.dj);
+            if (a > b)
+                continue;
+            auto* d = next + to.offset + static_cast<std::size_t>(a - to.lo);
+            auto const* p = prev + from.offset + static_cast<std::size_t>(
+                a - m.dj - from.lo);
+            auto n = static_cast<std::size_t>(b - a) + 1;
+            if (m.weight == 1)
+                for (std::size_t k = 0; k < n; ++k)
+                    add(d[k], p[k]);
+            else
+                for (std::size_t k = 0; k < n; ++k)
+                    add(d[k], p[k], m.weight);
+        }
+
+        if (!layout.folded())
+            return;
+        // Only the cells with j = 0 or j >= i - 1 have neighbours that fall
+        // outside of the octant 0 <= j <= i.
+        for (Loc j = lo; j <= hi; ++j) {
+            if (j > 1 && j < i - 1)
+                j = i - 1;
+            if (j > hi)
+                break;
+            auto& cell = next[to.offset + static_cast<std::size_t>(j
+                - to.lo)];
+            for (auto const& m: S::moves) {
+                auto si = i - m.di, sj = j - m.dj;
+                if (m.weight == 0 || (si >= 0 && sj >= 0 && sj <= si))
+                    continue;
+                auto offset = layout.offset(si, sj, t);
+                if (offset == Layout::npos)
+                    continue;
+                if (m.weight == 1)
+                    add(cell, prev[offset]);
+                else
+                    add(cell, prev[offset], m.weight);
+            }
+        }
+    }
+
+    /**
+     * @brief Compute rows `first` to `last` of layer t + 1 of a table from
+     * layer t, see `stencil_cells`. Only the given rows of layer t + 1 are
+     * written, so disjoint runs of rows can be computed in parallel.
+     * @param layout The layout of the table.
+     * @param t The layer to propagate from.
+     * @param first The first row of layer t + 1 to compute.
+     * @param last The last row of layer t + 1 to compute.
+     * @param prev The first cell of layer t.
+     * @param next The first cell of layer t + 1, all zero in these rows.
+     * @param add Called as add(a, b) and add(a, b, w), see `stencil_cells`.
+     */
+    template<typename S, typename C, typename Add>
+    void stencil_rows(Layout const& layout, Time const& t, Loc const& first,
+            Loc const& last, C const* prev, C* next, Add const& add) {
+        auto s = t + 1;
+        auto lo_row = std::max(first, layout.first_row(s));
+        auto hi_row = std::min(last, layout.last_row(s));
+        for (Loc i = lo_row; i <= hi_row; ++i) {
+            auto const& to = layout.row(i, s);
+            stencil_cells<S>(layout, t, i, to.lo, to.hi, prev, next, add);
+        }
+    }
+
+    /**
+     * @brief The layout of the cells that a walk with the moves of S from
+     * (0, 0) can reach without stepping on a blocked cell: per layer, the
+     * rows from the first to the last one with a reachable cell, each from
+     * its first to its last reachable cell.
+     *
+     * Only the cells next to those reached in the previous layer are looked
+     * at, so on maze-like maps this takes time and memory in the order of
+     * the reachable area rather than of the bound.
+     * @param bound The layout to restrict, not folded, e.g. a diamond.
+     * @param blocked The obstacles, covering the bound.
+     * @return The layout.
+     */
+    template<typename S>
+    Layout stencil_reach(Layout const& bound, Obstacles const& blocked) {
+        static_assert(is_stencil_v<S>, "S should be a stencil.");
+        if (bound.folded())
+            throw std::invalid_argument("Cannot restrict a folded layout.");
+        // The reachable cells of a row: those between lo and hi that are
+        // set in `reach`; empty if lo > hi.
+        struct Row {
+            Loc lo, hi;
+            std::vector<char> reach;
+        };
+        auto T = bound.max_time();
+        std::vector<Loc> first(T + 1, 0);
+        std::vector<std::vector<std::pair<Loc, Loc>>> cols(T + 1);
+        std::vector<Row> prev, next;
+        if (bound.offset(0, 0, 0) != Layout::npos
+                && !blocked.blocked(0, 0, 0)) {
+            prev.push_back({0, 0, {1}});
+            cols[0].emplace_back(0, 0);
+        }
+
+        for (Time t = 0; t < T && !prev.empty(); ++t) {
+            auto s = t + 1;
+            auto p0 = first[t], p1 = p0 + static_cast<Loc>(prev.size()) - 1;
+            auto reached = [&](Loc const& i, Loc const& j) {
+                if (i < p0 || i > p1)
+                    return false;
+                auto const& r = prev[static_cast<std::size_t>(i - p0)];
+                return j >= r.lo && j <= r.hi
+                    && r.reach[static_cast<std::size_t>(j - r.lo)];
+            };
+
+            next.clear();
+            auto lo_row = std::max(p0 - 1, bound.first_row(s));
+            auto hi_row = std::min(p1 + 1, bound.last_row(s));
+            first[s] = lo_row;
+            for (Loc i = lo_row; i <= hi_row; ++i) {
+                auto const& span = bound.row(i, s);
+                auto lo = std::numeric_limits<Loc>::max();
+                auto hi = std::numeric_limits<Loc>::min();
+                for (auto const& m: S::moves) {
+                    auto si = i - m.di;
+                    if (si < p0 || si > p1 || m.weight == 0)
+                        continue;
+                    auto const& r = prev[static_cast<std::size_t>(si - p0)];
+                    if (r.lo <= r.hi) {
+                        lo = std::min(lo, r.lo + m.dj);
+                        hi = std::max(hi, r.hi + m.dj);
+                    }
+                }
+                std::vector<char> reach;
+                auto wlo = std::max(lo, span.lo), whi = std::min(hi, span.hi);
+                for (auto j = wlo; j <= whi; ++j) {
+                    char r = 0;
+                    if (!blocked.blocked(i, j, s))
+                        for (auto const& m: S::moves)
+                            r = r || (m.weight > 0 && reached(i - m.di,
+                                j - m.dj));
+                    reach.push_back(r);
+                }
+                auto a = std::find(reach.begin(), reach.end(), 1);
+                auto b = std::find(reach.rbegin(), reach.rend(), 1).base();
+                Row row{0, -1, {}};
+                if (a != reach.end()) {
+                    row.lo = wlo + static_cast<Loc>(a - reach.begin());
+                    row.hi = wlo + static_cast<Loc>(b - reach.begin()) - 1;
+                    row.reach = std::vector<char>(a, b);
+                }
+                if (next.empty() && row.lo > row.hi)
+                    first[s] = i + 1;
+                else
+                    next.push_back(std::move(row));
+            }
+            while (!next.empty() && next.back().lo > next.back().hi)
+                next.pop_back();
+            for (auto const& row: next)
+                cols[s].emplace_back(row.lo, row.hi);
+            std::swap(prev, next);
+        }
+
+        return Layout(T, [&](Time const& t) noexcept {
+                return std::make_pair(first[t], first[t]
+                    + static_cast<Loc>(cols[t].size()) - 1);
+            }, [&](Loc const& i, Time const& t) noexcept {
+                return cols[t][static_cast<std::size_t>(i - first[t])];
+            });
+    }
+
+    /**
+     * @brief Compute layer t + 1 of a table from layer t, see `stencil_rows`.
+     * @param layout The layout of the table.
+     * @param t The layer to propagate from.
+     * @param prev The first cell of layer t.
+     * @param next The first cell of layer t + 1, all zero.
+     * @param add Called as add(a, b) and add(a, b, w), see `stencil_cells`.
+     */
+    template<typename S, typename C, typename Add>
+    void stencil_step(Layout const& layout, Time const& t, C const* prev,
+            C* next, Add const& add) {
+        stencil_rows<S>(layout, t, layout.first_row(t + 1),
+            layout.last_row(t + 1), prev, next, add);
+    }
+}
+#endif
@@ -0,0 +1,426 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STENCIL_DEFS_H
+#define STENCIL_DEFS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "dp.hpp"
+#include "layout.hpp"
+#include "obstacles.hpp"
+#include "pool.hpp"
+#include "problems.hpp"
+#include "rns.hpp"
+#include "sampler.hpp"
+#include "spill.hpp"
+#include "stencil.hpp"
+#include "stream.hpp"
+
+/*
+ * The definitions of everything that is a template on the stencil: the
+ * constructors of the DPs, `DP::reblock`, the sampler, and the functions of
+ * problems.hpp that take a stencil. The library instantiates them for the
+ * stencils of stencil.hpp; to use a stencil of your own, include this header
+ * where you use it, e.g.
+ *
+ *   #include "stencil_defs.hpp"
+ *   using Drift = dp::Weighted5<2, 3, 1, 1, 1>;
+ *   auto paths = prob::all_paths<dp::Cnt, Drift>(T, {0, 0});
+ */
+
+namespace dp {
+    template<typename C>
+    template<typename S>
+    void BasicDP<C>::propagate(unsigned threads) {
+        Pool pool(threads);
+        for (Time t = 0; t < T; ++t) {
+            auto const* prev = table.data() + layout.layer_begin(t);
+            auto* next = table.data() + layout.layer_begin(t + 1);
+            auto bands = layout.bands(t + 1, pool.size());
+            pool.run([&](unsigned w) {
+                    stencil_rows<S>(layout, t, bands[w], bands[w + 1] - 1,
+                        prev, next, CountAdd<C>{});
+                    blocked.clear(layout, t + 1, bands[w], bands[w + 1] - 1,
+                        next);
+                    if constexpr (std::is_floating_point_v<C>) {
+                        auto begin = band_offset(t + 1, bands[w]);
+                        Count<C>::scale(next + begin, band_offset(t + 1,
+                            bands[w + 1]) - begin, C{1} / stencil_weight<S>());
+                    }
+                });
+        }
+    }
+
+    template<typename C>
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    BasicDP<C>::BasicDP(Time max_time, S, std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells, Storage storage,
+            unsigned threads): T{std::move(max_time)},
+            blocked(T, blocked_cells, origin),
+            layout{storage == Storage::reachable ? stencil_reach<S>(
+            Layout::diamond(T, stencil_diagonal<S>()), blocked)
+            : Layout::make(storage, T, stencil_diagonal<S>())},
+            table(layout.size()), sparse{storage == Storage::reachable} {
+        if (layout.folded() && !stencil_symmetric<S>())
+            throw std::invalid_argument("The stencil is not symmetric.");
+        init();
+        propagate<S>(threads);
+        set_shift(std::move(origin));
+    }
+
+    template<typename C>
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    BasicDP<C>::BasicDP(Time max_time, S, Mask const& map,
+            std::pair<Loc, Loc> origin, unsigned threads):
+            T{std::move(max_time)}, blocked(T, map, origin),
+            layout{stencil_reach<S>(Layout::box(T, blocked.bounds(),
+            stencil_diagonal<S>()), blocked)}, table(layout.size()),
+            sparse{true} {
+        init();
+        propagate<S>(threads);
+        set_shift(std::move(origin));
+    }
+
+    template<typename C>
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    void BasicDP<C>::reblock(S, std::unordered_set<Blocked> const& added,
+            std::unordered_set<Blocked> const& removed, unsigned threads) {
+        auto [si, sj] = shift;
+        auto next = blocked;
+        for (auto const& cell: removed)
+            next.set(f * (cell.i - si), f * (cell.j - sj), Obstacles::never);
+        for (auto const& cell: added) {
+            Loc i = f * (cell.i - si), j = f * (cell.j - sj);
+            next.set(i, j, std::min(cell.start, next.from(i, j)));
+        }
+        if (layout.folded() && !next.symmetric())
+            throw std::invalid_argument("Obstacles are not symmetric.");
+        if (sparse) {
+            for (auto const& cell: removed) {
+                Loc i = f * (cell.i - si), j = f * (cell.j - sj);
+                if (next.from(i, j) > blocked.from(i, j))
+                    throw std::invalid_argument("Only the reachable cells are "
+                        "stored, so cells cannot be unblocked.");
+            }
+        }
+
+        // The cells whose blocking changed, from the first time it matters.
+        std::vector<Blocked> changed;
+        Time first = Obstacles::never;
+        for (auto const* cells: {&removed, &added}) {
+            for (auto const& cell: *cells) {
+                Loc i = f * (cell.i - si), j = f * (cell.j - sj);
+                auto a = blocked.from(i, j), b = next.from(i, j);
+                if (a != b) {
+                    changed.emplace_back(i, j, std::min(a, b));
+                    first = std::min(first, std::min(a, b));
+                }
+            }
+        }
+        blocked = std::move(next);
+
+        Pool pool(threads);
+        for (Time t = first; t <= T; ++t) {
+            auto const* prev = table.data() + layout.layer_begin(t > 0 ? t - 1
+                : 0);
+            auto* cells = table.data() + layout.layer_begin(t);
+            auto bands = layout.bands(t, pool.size());
+            pool.run([&](unsigned w) {
+                    for (Loc i = bands[w]; i < bands[w + 1]; ++i) {
+                        // The hull of the cones in this row.
+                        auto lo = std::numeric_limits<Loc>::max();
+                        auto hi = std::numeric_limits<Loc>::min();
+                        for (auto const& c: changed) {
+                            if (c.start > t)
+                                continue;
+                            auto r = static_cast<Loc>(t - c.start);
+                            if (std::abs(i - c.i) > r)
+                                continue;
+                            if (!stencil_diagonal<S>())
+                                r -= std::abs(i - c.i);
+                            lo = std::min(lo, c.j - r);
+                            hi = std::max(hi, c.j + r);
+                        }
+                        auto const& span = layout.row(i, t);
+                        lo = std::max(lo, span.lo);
+                        hi = std::min(hi, span.hi);
+                        if (lo > hi)
+                            continue;
+                        auto* d = cells + span.offset
+                            + static_cast<std::size_t>(lo - span.lo);
+                        auto n = static_cast<std::size_t>(hi - lo) + 1;
+                        std::fill(d, d + n, C{0});
+                        if (t == 0)
+                            *d = 1;
+                        else
+                            stencil_cells<S>(layout, t - 1, i, lo, hi, prev,
+                                cells, CountAdd<C>{});
+                        blocked.clear(layout, t, i, i, cells);
+                        if constexpr (std::is_floating_point_v<C>) {
+                            if (t > 0)
+                                Count<C>::scale(d, n, C{1}
+                                    / stencil_weight<S>());
+                        }
+                    }
+                });
+        }
+    }
+
+    template<typename C>
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    BasicSweep<C>::BasicSweep(Time max_time, S, std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells, Time keep,
+            Storage storage): T{std::move(max_time)}, live{keep},
+            layout{Layout::make(storage, T, stencil_diagonal<S>())},
+            stride{layout.layer_size(T)}, ring(live * stride),
+            shift{std::move(origin)} {
+        init(blocked_cells);
+        step = [this](Time const& s, C const* prev, C* next) {
+            stencil_step<S>(layout, s, prev, next, CountAdd<C>{});
+        };
+    }
+
+    template<typename C>
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    BasicCheckpoints<C>::BasicCheckpoints(Time max_time, S,
+            std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells, Time spacing):
+            T{std::move(max_time)}, layout{Layout::diamond(T,
+            stencil_diagonal<S>())}, every{spacing == 0
+            ? BasicCheckpoints::spacing(T) : spacing},
+            blocked{T, blocked_cells, origin}, shift{std::move(origin)} {
+        step = [this](Time const& s, C const* prev, C* next) {
+            stencil_step<S>(layout, s, prev, next, CountAdd<C>{});
+            blocked.clear(layout, s + 1, layout.first_row(s + 1),
+                layout.last_row(s + 1), next);
+        };
+        back = [](BasicLayer<C> const& before, Loc const& i, Loc const& j,
+                C const& total, Stream& gen) {
+            return stencil_back<S>([&](Loc const& a, Loc const& b) {
+                    return before.at(a, b);
+                }, i, j, total, gen);
+        };
+
+        std::vector<C> prev(layout.layer_size(T)), next(prev.size());
+        if (!blocked.blocked(0, 0, 0))
+            prev[layout.offset(0, 0, 0)] = 1;
+        for (Time t = 0; ; ++t) {
+            if (t % every == 0)
+                checkpoints.emplace_back(prev.begin(),
+                    prev.begin() + static_cast<std::ptrdiff_t>(
+                    layout.layer_size(t)));
+            if (t == T)
+                break;
+            for (std::size_t k = 0; k < layout.layer_size(t + 1); ++k)
+                next[k] = 0;
+            step(t, prev.data(), next.data());
+            std::swap(prev, next);
+        }
+    }
+
+    template<typename C>
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    BasicSpill<C>::BasicSpill(Time max_time, S, std::string const& dir,
+            std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells,
+            std::size_t cache, Storage storage): T{std::move(max_time)},
+            layout{Layout::make(storage, T, stencil_diagonal<S>())},
+            shift{std::move(origin)}, capacity{cache}, ahead{T + 1} {
+        fill(dir, blocked_cells, [this](Time const& t, C const* prev,
+                C* next) {
+                stencil_step<S>(layout, t, prev, next, CountAdd<C>{});
+            });
+    }
+
+    template<typename S, std::enable_if_t<is_stencil_v<S>, int>>
+    RnsDP::RnsDP(Time max_time, S, std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells, Storage storage):
+            T{std::move(max_time)}, layout{Layout::make(storage, T,
+            stencil_diagonal<S>())} {
+        fill(std::move(origin), blocked_cells, stencil_weight<S>(),
+            [this](Time const& t, std::uint64_t const* prev,
+            std::uint64_t* next, std::uint64_t const& p) {
+                stencil_step<S>(layout, t, prev, next, ResidueAdd{p});
+            });
+    }
+
+    template<typename C, typename S>
+    auto BasicSampler<C, S>::counts(Loc const& i, Loc const& j,
+            Time const& t) const -> std::array<Cnt, N> {
+        std::array<Cnt, N> res;
+        for (std::size_t k = 0; k < N; ++k) {
+            auto const& m = S::moves[k];
+            if (m.weight > 0)
+                res[k] = to_cnt(paths->at(i - m.di, j - m.dj, t - 1))
+                    * m.weight;
+        }
+        return res;
+    }
+
+    template<typename C, typename S>
+    BasicSampler<C, S>::BasicSampler(Time max_time, BasicDP<C> const& all,
+            std::pair<Loc, Loc> finish, bool exact_mode, unsigned threads):
+            paths{&all}, T{std::move(max_time)}, end{std::move(finish)},
+            exact{exact_mode}, layout{Layout::diamond(T,
+            stencil_diagonal<S>())},
+            table(layout.layer_begin(T)) {
+        auto [ei, ej] = end;
+        if (paths->at(ei, ej, T) == 0)
+            throw std::invalid_argument("The end point is not reachable.");
+
+        Pool pool(threads);
+        for (Time s = 0; s < T; ++s) {
+            auto t = T - s;
+            auto* cells = table.data() + layout.layer_begin(s);
+            auto bands = layout.bands(s, pool.size());
+            pool.run([&](unsigned w) {
+                    for (Loc i = bands[w]; i < bands[w + 1]; ++i) {
+                        auto const& span = layout.row(i, s);
+                        for (Loc j = span.lo; j <= span.hi; ++j) {
+                            if (paths->at(ei + i, ej + j, t) == 0)
+                                continue;
+                            auto& cell = cells[span.offset
+                                + static_cast<std::size_t>(j - span.lo)];
+                            auto c = counts(ei + i, ej + j, t);
+                            Cnt total = 0, sum = 0;
+                            for (auto const& x: c)
+                                total += x;
+                            if (total == 0)
+                                throw std::invalid_argument("The DP does not "
+                                    "match the stencil.");
+                            cell.live = 0;
+                            for (std::size_t k = 0; k < N; ++k) {
+                                sum += c[k];
+                                if (c[k] > 0)
+                                    cell.live |= 1u << k;
+                                if (k == N - 1)
+                                    break;
+                                Cnt cut = (sum << 32) / total;
+                                cell.cut[k] = cut > 0xffffffffu ? 0xffffffffu
+                                    : static_cast<std::uint32_t>(cut.get_ui());
+                            }
+                        }
+                    }
+                });
+        }
+    }
+}
+
+namespace prob {
+    /**
+     * @brief Walk back from `end` to the start of `paths` in `T` steps,
+     * choosing every step with the probability given by the path counts, see
+     * `dp::stencil_back`; the walk must be possible.
+     * @param T The number of time steps in the trajectory.
+     * @param paths The DP for computing all paths from the start, with the
+     * moves of S, e.g. `DP` or `View`.
+     * @param end The endpoint of the trajectory.
+     * @param gen The generator of uniform 64-bit words.
+     * @param out Where to write the T + 1 points, by time.
+     */
+    template<typename S, typename Table, typename Gen>
+    void walk_back(dp::Time const& T, Table const& paths,
+            std::pair<dp::Loc, dp::Loc> const& end, Gen& gen,
+            std::pair<dp::Loc, dp::Loc>* out) {
+        auto cell = end;
+        for (dp::Time t = T; t > 0; --t) {
+            out[t] = cell;
+            auto [ci, cj] = cell;
+            cell = dp::stencil_back<S>([&](dp::Loc const& i, dp::Loc const& j) {
+                    return paths.at(i, j, t - 1);
+                }, ci, cj, paths.at(ci, cj, t), gen);
+        }
+        out[0] = cell;
+    }
+
+    template<typename C, typename S>
+    dp::BasicDP<C> all_paths(dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+            std::unordered_set<dp::Blocked> const& blocked, dp::Storage storage,
+            unsigned threads) {
+        dp::BasicDP<C> res(std::move(T), S{}, std::move(start), blocked,
+            storage, threads);
+        return res;
+    }
+
+    template<typename C, typename S>
+    std::vector<std::pair<dp::Loc, dp::Loc>> generate_path(dp::Time const& T,
+            dp::BasicDP<C> const& paths,
+            std::pair<dp::Loc, dp::Loc> const& end) {
+        auto [ci, cj] = end;
+        if (paths.at(ci, cj, T) == 0)
+            return {};
+
+        std::vector<std::pair<dp::Loc, dp::Loc>> ret(T + 1);
+        std::random_device rd;
+        std::mt19937_64 gen(rd());
+        walk_back<S>(T, paths, end, gen, ret.data());
+        return ret;
+    }
+
+    /**
+     * @brief Generate paths as in `generate_paths`, from a DP or a view.
+     */
+    template<typename S, typename Table>
+    std::vector<std::pair<dp::Loc, dp::Loc>> walk_back_many(dp::Time const& T,
+            Table const& paths, std::pair<dp::Loc, dp::Loc> const& end,
+            std::size_t count, std::uint64_t seed, unsigned threads) {
+        auto [ci, cj] = end;
+        if (paths.at(ci, cj, T) == 0)
+            return {};
+
+        auto len = static_cast<std::size_t>(T) + 1;
+        std::vector<std::pair<dp::Loc, dp::Loc>> ret(count * len);
+        dp::Pool pool(threads);
+        pool.run([&](unsigned w) {
+                auto first = count * w / pool.size();
+                auto last = count * (w + 1) / pool.size();
+                for (auto k = first; k < last; ++k) {
+                    dp::Stream gen(seed, k);
+                    walk_back<S>(T, paths, end, gen, ret.data() + k * len);
+                }
+            });
+        return ret;
+    }
+
+    template<typename C, typename S>
+    std::vector<std::pair<dp::Loc, dp::Loc>> generate_paths(dp::Time const& T,
+            dp::BasicDP<C> const& paths, std::pair<dp::Loc, dp::Loc> const& end,
+            std::size_t count, std::uint64_t seed, unsigned threads) {
+        return walk_back_many<S>(T, paths, end, count, seed, threads);
+    }
+
+    template<typename C, typename S>
+    std::vector<std::pair<dp::Loc, dp::Loc>> generate_paths_checkpointed(
+            dp::Time T, std::pair<dp::Loc, dp::Loc> start,
+            std::pair<dp::Loc, dp::Loc> const& end, std::size_t count,
+            std::uint64_t seed, std::unordered_set<dp::Blocked> const& blocked,
+            dp::Time spacing) {
+        dp::BasicCheckpoints<C> paths(std::move(T), S{},
+            std::move(start), blocked, spacing);
+        return paths.sample(end, count, seed);
+    }
+}
+#endif
@@ -0,0 +1,223 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "stream.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "stencil_defs.hpp"
+
+namespace dp {
+    template<typename C>
+    BasicSweep<C>::BasicSweep(Time max_time,
+            std::function<C(BasicLayer<C> const&, Loc const&, Loc const&)> prop,
+            std::pair<Loc, Loc> origin,
+            std::unordered_set<Blocked> const& blocked_cells, Time keep,
+            Storage storage): T{std::move(max_time)}, live{keep},
+            layout{Layout::make(storage, T)}, stride{layout.layer_size(T)},
+            ring(live * stride), shift{std::move(origin)} {
+        init(blocked_cells);
+        step = [this, prop](Time const& s, C const* prev, C* next) {
+            BasicLayer<C> from(layout, s, prev);
+            for (Loc i = layout.first_row(s + 1); i <= layout.last_row(s + 1);
+                    ++i) {
+                auto const& span = layout.row(i, s + 1);
+                auto* cell = next + span.offset;
+                for (Loc j = span.lo; j <= span.hi; ++j, ++cell)
+                    *cell = prop(from, i, j);
+            }
+        };
+    }
+
+    template<typename C>
+    void BasicSweep<C>::init(std::unordered_set<Blocked> const& blocked_cells) {
+        if (live < 2)
+            throw std::invalid_argument("Please keep at least two layers.");
+
+        blocked = Obstacles(T, blocked_cells, shift);
+        if (layout.folded() && !blocked.symmetric())
+            throw std::invalid_argument("Obstacles are not symmetric.");
+
+        if (!blocked.blocked(0, 0, 0))
+            slot(0)[layout.offset(0, 0, 0)] = 1;
+    }
+
+    template<typename C>
+    C* BasicSweep<C>::slot(Time const& s) {
+        return ring.data() + (s % live) * stride;
+    }
+
+    template<typename C>
+    Time BasicSweep<C>::time() const {
+        return t;
+    }
+
+    template<typename C>
+    void BasicSweep<C>::advance() {
+        if (t >= T)
+            throw std::out_of_range("The last layer has been computed.");
+
+        auto* next = slot(t + 1);
+        for (std::size_t k = 0; k < layout.layer_size(t + 1); ++k)
+            next[k] = 0;
+        step(t, slot(t), next);
+        ++t;
+        blocked.clear(layout, t, layout.first_row(t), layout.last_row(t), next);
+    }
+
+    template<typename C>
+    BasicLayer<C> BasicSweep<C>::layer(Time const& s) const {
+        if (s > t || t - s >= live)
+            throw std::out_of_range("This layer is not live.");
+        return {layout, s, ring.data() + (s % live) * stride, shift};
+    }
+
+// The constructors for every compiled stencil.
+#define SWEEP_STENCIL(C, S) \
+    template BasicSweep<C>::BasicSweep(Time, S, std::pair<Loc, Loc>, \
+        std::unordered_set<Blocked> const&, Time, Storage);
+#define SWEEP_COUNT(C) \
+    template class BasicSweep<C>; \
+    SWEEP_STENCIL(C, Walk4) SWEEP_STENCIL(C, Lazy5) SWEEP_STENCIL(C, King8) \
+    SWEEP_STENCIL(C, Lazy9)
+
+    SWEEP_COUNT(std::uint64_t)
+    SWEEP_COUNT(Wide)
+    SWEEP_COUNT(Cnt)
+
+#undef SWEEP_COUNT
+#undef SWEEP_STENCIL
+
+    template<typename C>
+    Time BasicCheckpoints<C>::spacing(Time max_time) {
+        // The cells in the diamond before layer t, with 2s^2 + 2s + 1 cells
+        // in every layer s.
+        auto below = [](Time t) {
+            auto n = static_cast<std::size_t>(t);
+            return n * (2 * n * n + 1) / 3;
+        };
+        Time best = 1;
+        auto least = std::numeric_limits<std::size_t>::max();
+        for (Time k = 1; k <= max_time; ++k) {
+            std::size_t cells = 0, run = 0;
+            for (Time t = 0; t <= max_time; t += k) {
+                cells += below(t + 1) - below(t);
+                auto last = std::min(t + k, max_time);
+                run = std::max(run, below(last + 1) - below(t));
+            }
+            if (cells + run < least) {
+                least = cells + run;
+                best = k;
+            }
+        }
+        return best;
+    }
+
+    template<typename C>
+    Time BasicCheckpoints<C>::distance() const {
+        return every;
+    }
+
+    template<typename C>
+    std::size_t BasicCheckpoints<C>::peak() const {
+        std::size_t cells = 0;
+        for (auto const& layer: checkpoints)
+            cells += layer.size();
+        std::size_t run = 0;
+        for (Time first = 0; first < T; first += every) {
+            auto last = std::min(first + every, T);
+            run = std::max(run, layout.layer_begin(last + 1)
+                - layout.layer_begin(first));
+        }
+        return cells + run;
+    }
+
+    template<typename C>
+    void BasicCheckpoints<C>::segment(Time const& first, Time const& last,
+            std::vector<C>& cells) const {
+        auto base = layout.layer_begin(first);
+        cells.assign(layout.layer_begin(last + 1) - base, C{0});
+        auto const& start = checkpoints[first / every];
+        std::copy(start.begin(), start.end(), cells.begin());
+        for (Time t = first; t < last; ++t)
+            step(t, cells.data() + (layout.layer_begin(t) - base),
+                cells.data() + (layout.layer_begin(t + 1) - base));
+    }
+
+    template<typename C>
+    std::vector<std::pair<Loc, Loc>> BasicCheckpoints<C>::sample(
+            std::pair<Loc, Loc> const& end, std::size_t count,
+            std::uint64_t seed) const {
+        auto [si, sj] = shift;
+        Loc ei = end.first - si, ej = end.second - sj;
+        auto len = static_cast<std::size_t>(T) + 1;
+        std::vector<std::pair<Loc, Loc>> ret(count * len);
+        std::vector<Stream> gens;
+        for (std::size_t p = 0; p < count; ++p) {
+            gens.emplace_back(seed, p);
+            ret[p * len + T] = {ei, ej};
+        }
+
+        std::vector<C> cells;
+        for (auto first = T == 0 ? 0 : (T - 1) / every * every; ;
+                first -= every) {
+            auto last = std::min(first + every, T);
+            segment(first, last, cells);
+            auto base = layout.layer_begin(first);
+            auto view = [&](Time const& t) {
+                return BasicLayer<C>(layout, t, cells.data()
+                    + (layout.layer_begin(t) - base));
+            };
+            if (last == T && view(T).at(ei, ej) == 0)
+                return {};
+            for (Time t = last; t > first; --t) {
+                auto here = view(t), before = view(t - 1);
+                for (std::size_t p = 0; p < count; ++p) {
+                    auto [ci, cj] = ret[p * len + t];
+                    C total = here.at(ci, cj);
+                    ret[p * len + t - 1] = back(before, ci, cj, total,
+                        gens[p]);
+                }
+            }
+            if (first == 0)
+                break;
+        }
+
+        for (auto& [i, j]: ret) {
+            i += si;
+            j += sj;
+        }
+        return ret;
+    }
+
+// The constructors for every compiled stencil.
+#define CHECKPOINTS_STENCIL(C, S) \
+    template BasicCheckpoints<C>::BasicCheckpoints(Time, S, \
+        std::pair<Loc, Loc>, std::unordered_set<Blocked> const&, Time);
+#define CHECKPOINTS_COUNT(C) \
+    template class BasicCheckpoints<C>; \
+    CHECKPOINTS_STENCIL(C, Walk4) CHECKPOINTS_STENCIL(C, Lazy5) \
+    CHECKPOINTS_STENCIL(C, King8) CHECKPOINTS_STENCIL(C, Lazy9)
+
+    CHECKPOINTS_COUNT(std::uint64_t)
+    CHECKPOINTS_COUNT(Wide)
+    CHECKPOINTS_COUNT(Cnt)
+
+#undef CHECKPOINTS_COUNT
+#undef CHECKPOINTS_STENCIL
+
+    Cnt uniform_step(Layer const& r, Loc const& i, Loc const& j) {
+        return r.at(i, j) + r.at(i - 1, j) + r.at(i + 1, j) + r.at(i, j - 1)
+            + r.at(i, j + 1);
+    }
+}
@@ -0,0 +1,230 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "defs.hpp"
+#include "dp.hpp"
+#include "layout.hpp"
+#include "obstacles.hpp"
+#include "stencil.hpp"
+
+namespace dp {
+    /**
+     * The same dynamic program as `DP`, computed one layer at a time while
+     * keeping only the most recent layers in memory: O(T^2) instead of
+     * O(T^3) cells.
+     */
+    template<typename C>
+    class BasicSweep {
+        /// The maximum number of steps from (0, 0).
+        Time const T;
+        /// The number of layers kept in memory, at least 2.
+        Time const live;
+        /// Which cells of every layer are stored: those within reach.
+        Layout layout;
+        /// The stride between the slots of `ring`.
+        std::size_t stride;
+        /// The live layers; layer t is in slot t % live.
+        std::vector<C> ring;
+        /// The times at which the cells get blocked.
+        Obstacles blocked;
+        /// Computes the layer after the given one, from and into a slot.
+        std::function<void(Time const&, C const*, C*)> step;
+        /// The starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift;
+        /// The last computed layer.
+        Time t{0};
+
+        /**
+         * @brief The first cell of the slot for layer s.
+         */
+        C* slot(Time const& s);
+
+        /**
+         * @brief Shift the blocked cells to the origin, check them against the
+         * storage mode, and set up layer 0.
+         * @param blocked_cells The set of blocked cells.
+         */
+        void init(std::unordered_set<Blocked> const& blocked_cells);
+
+    public:
+        /**
+         * @brief Prepare the computation of the number of paths in
+         * W_{x, y, t} for all possible (x, y) and all t <= T, and compute the
+         * layer for t = 0.
+         * @param max_time The value of T (allowed number of steps).
+         * @param prop The propagation function, see e.g. uniform_step.
+         * @param origin The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param keep The number of layers to keep in memory, at least 2.
+         * @param storage Which cells to store, see `DP::DP`.
+         */
+        BasicSweep(Time max_time,
+            std::function<C(BasicLayer<C> const&, Loc const&, Loc const&)> prop,
+            std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            Time keep = 2, Storage storage = Storage::diamond);
+
+        /**
+         * @brief Prepare the computation for a compile-time stencil, which is
+         * much faster than passing a propagation function.
+         * @param max_time The value of T (allowed number of steps).
+         * @param stencil The stencil, e.g. `Lazy5{}`.
+         * @param origin The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param keep The number of layers to keep in memory, at least 2.
+         * @param storage Which cells to store, see `DP::DP`.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        BasicSweep(Time max_time, S stencil,
+            std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            Time keep = 2, Storage storage = Storage::diamond);
+
+        BasicSweep(BasicSweep const&) = delete;
+        BasicSweep& operator=(BasicSweep const&) = delete;
+
+        /**
+         * @brief The last computed layer.
+         */
+        Time time() const;
+
+        /**
+         * @brief Compute the next layer, dropping the oldest live one. Throw
+         * an exception if layer T has been computed already.
+         */
+        void advance();
+
+        /**
+         * @brief A view of a live layer, valid until it is dropped.
+         * @param s The time, from time() - keep + 1 to time().
+         * @return The layer, accessible with at(i, j) after the shift.
+         */
+        BasicLayer<C> layer(Time const& s) const;
+    };
+
+    using Sweep = BasicSweep<Cnt>;
+
+    /**
+     * The same dynamic program as `DP`, with only every k-th layer kept as a
+     * checkpoint: O(T^3 / k + k T^2) cells instead of O(T^3), so O(T^2.5) for
+     * k around sqrt(T / 3). Paths are sampled backwards from the end as in
+     * `generate_path`, recomputing the layers between two checkpoints from
+     * the earlier one when the paths get there.
+     */
+    template<typename C>
+    class BasicCheckpoints {
+        /// The maximum number of steps from (0, 0).
+        Time const T;
+        /// Which cells of every layer are stored: those within reach.
+        Layout layout;
+        /// The distance k between two checkpoints.
+        Time every;
+        /// The layers 0, k, 2k, ..., in order.
+        std::vector<std::vector<C>> checkpoints;
+        /// The times at which the cells get blocked.
+        Obstacles blocked;
+        /// Computes the layer after the given one, blocked cells included.
+        std::function<void(Time const&, C const*, C*)> step;
+        /// Picks the cell one step back from a cell, see `stencil_back`.
+        std::function<std::pair<Loc, Loc>(BasicLayer<C> const&, Loc const&,
+            Loc const&, C const&, Stream&)> back;
+        /// The starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift;
+
+        /**
+         * @brief Recompute the layers between two checkpoints.
+         * @param first The first layer, a checkpoint.
+         * @param last The last layer, at most T.
+         * @param cells Filled with the layers from first to last, back to back
+         * in the layout.
+         */
+        void segment(Time const& first, Time const& last,
+            std::vector<C>& cells) const;
+
+    public:
+        /**
+         * @brief Compute the checkpoints for the number of paths in
+         * W_{x, y, t} for all possible (x, y) and all t <= T.
+         * @param max_time The value of T (allowed number of steps).
+         * @param stencil The stencil, e.g. `Lazy5{}`.
+         * @param origin The starting point of the paths.
+         * @param blocked_cells The set of blocked cells.
+         * @param spacing The distance between two checkpoints, 0 for
+         * `spacing(T)`.
+         */
+        template<typename S, std::enable_if_t<is_stencil_v<S>, int> = 0>
+        BasicCheckpoints(Time max_time, S stencil,
+            std::pair<Loc, Loc> origin = {0, 0},
+            std::unordered_set<Blocked> const& blocked_cells = {},
+            Time spacing = 0);
+
+        BasicCheckpoints(BasicCheckpoints const&) = delete;
+        BasicCheckpoints& operator=(BasicCheckpoints const&) = delete;
+
+        /**
+         * @brief The distance between two checkpoints that needs the fewest
+         * cells in memory at a time, checkpoints and one run of layers
+         * between them together; about sqrt(T / 3).
+         * @param max_time The value of T.
+         */
+        static Time spacing(Time max_time);
+
+        /**
+         * @brief The distance between two checkpoints.
+         */
+        Time distance() const;
+
+        /**
+         * @brief The number of cells kept in memory at most, including the
+         * layers recomputed by `sample`.
+         */
+        std::size_t peak() const;
+
+        /**
+         * @brief Generate `count` paths from the start to `end` in T steps,
+         * with the same distribution as `generate_path`. All paths are walked
+         * back together, so every run of layers is recomputed only once.
+         * @param end The endpoint of the generated trajectories.
+         * @param count The number of trajectories.
+         * @param seed The seed of the random streams, see `Stream`; path p
+         * uses `Stream(seed, p)`.
+         * @return The trajectories one after another, so the kth item of path
+         * p is at p * (T + 1) + k; or an empty vector if the path is
+         * impossible.
+         */
+        std::vector<std::pair<Loc, Loc>> sample(std::pair<Loc, Loc> const& end,
+            std::size_t count, std::uint64_t seed) const;
+    };
+
+    using Checkpoints = BasicCheckpoints<Cnt>;
+
+    /**
+     * @brief Uniform propagation for the sweep, the equivalent of
+     * `uniform_prop`: one path in each neighbouring direction, one path for
+     * staying in the same spot.
+     * @param r The layer at time t, without shift.
+     * @param i First dimension.
+     * @param j Second dimension.
+     * @return The value at (i, j) at time t + 1.
+     */
+    Cnt uniform_step(Layer const& r, Loc const& i, Loc const& j);
+}
+#endif
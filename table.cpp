@@ -0,0 +1,285 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include "table.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    static_assert(sizeof(dp::Span) == 16 && sizeof(std::size_t) == 8,
+        "The binary format needs 64-bit offsets.");
+
+    /// The first bytes of every file.
+    constexpr char magic[8] = {'B', 'R', 'I', 'D', 'G', 'L', 'T', '\0'};
+    /// The version of the format.
+    constexpr std::uint32_t version = 2;
+    /// A word that reads the same only in the byte order of the writer.
+    constexpr std::uint64_t byte_order = 0x0102030405060708;
+    /// The flags in the header.
+    constexpr std::uint32_t folded = 1, time_flipped = 2, coords_flipped = 4;
+
+    /**
+     * The header of the format.
+     */
+    struct Header {
+        char magic[8];
+        std::uint32_t version, flags, T;
+        std::int32_t si, sj;
+        std::uint32_t width;
+        std::uint64_t rows, cells, order, padding;
+    };
+    static_assert(sizeof(Header) == 64, "The header should be 64 bytes.");
+
+    /**
+     * @brief Check that the index of a table only points into the table, so
+     * that lookups need no checks of their own: the rows and cells of the
+     * layers follow each other, and every row lies within its layer.
+     * @param h The header, with sizes that match the file.
+     * @param first The first row of every layer.
+     * @param rows The index of the first row of every layer, and the end.
+     * @param begin The first cell of every layer, and the end.
+     * @param spans The rows of all layers.
+     * @return Whether the index is consistent.
+     */
+    bool valid_index(Header const& h, std::int64_t const* first,
+            std::uint64_t const* rows, std::uint64_t const* begin,
+            dp::Span const* spans) {
+        std::size_t layers = static_cast<std::size_t>(h.T) + 1;
+        if (rows[0] != 0 || rows[layers] != h.rows || begin[0] != 0
+                || begin[layers] != h.cells)
+            return false;
+        for (std::size_t t = 0; t < layers; ++t) {
+            if (rows[t] > rows[t + 1] || begin[t] > begin[t + 1]
+                    || first[t] < std::numeric_limits<dp::Loc>::min()
+                    || first[t] > std::numeric_limits<dp::Loc>::max())
+                return false;
+            auto cells = begin[t + 1] - begin[t];
+            for (auto k = rows[t]; k < rows[t + 1]; ++k) {
+                auto const& span = spans[k];
+                if (span.lo > span.hi)
+                    continue;
+                auto n = static_cast<std::uint64_t>(std::int64_t{span.hi}
+                    - span.lo + 1);
+                if (span.offset > cells || n > cells - span.offset)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Write the elements of a vector to a stream as raw bytes.
+     */
+    template<typename T>
+    void dump(std::ofstream& out, std::vector<T> const& v) {
+        out.write(reinterpret_cast<char const*>(v.data()),
+            static_cast<std::streamsize>(v.size() * sizeof(T)));
+    }
+}
+
+namespace dp {
+    template<typename C>
+    void write_table(std::string const& path, Layout const& layout,
+            C const* cells, TableInfo const& info) {
+        auto T = layout.max_time();
+        std::size_t width = 1;
+        for (std::size_t k = 0; k < layout.size(); ++k)
+            width = std::max(width, Count<C>::words(cells[k]));
+
+        std::vector<std::int64_t> first;
+        std::vector<std::uint64_t> rows, begin;
+        std::vector<Span> spans;
+        for (Time t = 0; t <= T; ++t) {
+            first.push_back(layout.first_row(t));
+            rows.push_back(spans.size());
+            begin.push_back(layout.layer_begin(t));
+            for (Loc i = layout.first_row(t); i <= layout.last_row(t); ++i)
+                spans.push_back(layout.row(i, t));
+        }
+        rows.push_back(spans.size());
+        begin.push_back(layout.size());
+
+        Header h{};
+        std::memcpy(h.magic, magic, sizeof(magic));
+        h.version = version;
+        h.flags = (layout.folded() ? folded : 0) | (info.flip ? time_flipped
+            : 0) | (info.f < 0 ? coords_flipped : 0);
+        h.T = T;
+        h.si = info.shift.first;
+        h.sj = info.shift.second;
+        h.width = static_cast<std::uint32_t>(width);
+        h.rows = spans.size();
+        h.cells = layout.size();
+        h.order = byte_order;
+
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<char const*>(&h), sizeof(h));
+        dump(out, first);
+        dump(out, rows);
+        dump(out, begin);
+        dump(out, spans);
+        // Convert the cells a block at a time.
+        std::vector<std::uint64_t> block;
+        for (std::size_t k = 0; k < layout.size(); k += 4096) {
+            auto n = std::min<std::size_t>(4096, layout.size() - k);
+            block.resize(n * width);
+            for (std::size_t c = 0; c < n; ++c)
+                Count<C>::put(cells[k + c], block.data() + c * width,
+                    width);
+            dump(out, block);
+        }
+        if (!out)
+            throw std::runtime_error("Could not write " + path + ".");
+    }
+
+    template<typename C>
+    void write_table(std::string const& path, BasicGrid<C> const& grid) {
+        auto r = grid.radius();
+        Layout layout(0, [r](Time const&) {
+                return std::make_pair(-r, r);
+            }, [r](Loc const&, Time const&) {
+                return std::make_pair(-r, r);
+            });
+        TableInfo info;
+        info.shift = grid.origin();
+        write_table(path, layout, grid.data(), info);
+    }
+
+    MappedTable::MappedTable(std::string const& path) {
+        auto fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("Could not open " + path + ".");
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size)
+                < sizeof(Header)) {
+            close(fd);
+            throw std::runtime_error("Not a table: " + path + ".");
+        }
+        length = static_cast<std::size_t>(st.st_size);
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED)
+            throw std::runtime_error("Could not map " + path + ".");
+
+        auto const* bytes = static_cast<char const*>(base);
+        auto const* h = static_cast<Header const*>(base);
+        if (std::memcmp(h->magic, magic, sizeof(magic)) != 0
+                || h->version != version) {
+            munmap(base, length);
+            throw std::runtime_error("Not a table: " + path + ".");
+        }
+        if (h->order != byte_order) {
+            munmap(base, length);
+            throw std::runtime_error("The table " + path
+                + " was written with another byte order.");
+        }
+        // The sizes are bounded by the file first, so that they cannot
+        // overflow.
+        std::size_t layers = static_cast<std::size_t>(h->T) + 1;
+        if (h->width == 0 || h->rows > length / sizeof(Span)
+                || h->cells > length / 8 / h->width
+                || sizeof(Header) + 8 * layers + 16 * (layers + 1)
+                    + sizeof(Span) * h->rows + 8 * h->width * h->cells
+                    != length) {
+            munmap(base, length);
+            throw std::runtime_error("Not a table: " + path + ".");
+        }
+
+        T = h->T;
+        fold = h->flags & folded;
+        info.shift = {h->si, h->sj};
+        info.flip = h->flags & time_flipped;
+        info.f = h->flags & coords_flipped ? -1 : 1;
+        width = h->width;
+        bytes += sizeof(Header);
+        first = reinterpret_cast<std::int64_t const*>(bytes);
+        bytes += 8 * layers;
+        rows = reinterpret_cast<std::uint64_t const*>(bytes);
+        bytes += 8 * (layers + 1);
+        begin = reinterpret_cast<std::uint64_t const*>(bytes);
+        bytes += 8 * (layers + 1);
+        spans = reinterpret_cast<Span const*>(bytes);
+        bytes += sizeof(Span) * h->rows;
+        words = reinterpret_cast<std::uint64_t const*>(bytes);
+        if (!valid_index(*h, first, rows, begin, spans)) {
+            munmap(base, length);
+            throw std::runtime_error("Corrupt index in " + path + ".");
+        }
+    }
+
+    MappedTable::~MappedTable() {
+        munmap(base, length);
+    }
+
+    Time MappedTable::max_time() const {
+        return T;
+    }
+
+    std::size_t MappedTable::cell_width() const {
+        return width;
+    }
+
+    std::uint64_t const* MappedTable::cell(Loc const& i, Loc const& j,
+            Time const& t) const {
+        if (t > T)
+            return nullptr;
+        auto [si, sj] = info.shift;
+        std::int64_t a = info.f * (std::int64_t{i} - si);
+        std::int64_t b = info.f * (std::int64_t{j} - sj);
+        auto tf = info.flip ? T - t : t;
+        if (fold) {
+            a = std::abs(a);
+            b = std::abs(b);
+            if (b > a)
+                std::swap(a, b);
+        }
+        auto count = static_cast<std::int64_t>(rows[tf + 1] - rows[tf]);
+        if (a < first[tf] || a >= first[tf] + count)
+            return nullptr;
+        auto const& span = spans[rows[tf] + static_cast<std::uint64_t>(a
+            - first[tf])];
+        if (b < span.lo || b > span.hi)
+            return nullptr;
+        auto k = begin[tf] + span.offset + static_cast<std::uint64_t>(b
+            - span.lo);
+        return words + k * width;
+    }
+
+    Cnt MappedTable::at(Loc const& i, Loc const& j, Time const& t) const {
+        Cnt res;
+        auto const* w = cell(i, j, t);
+        if (w != nullptr)
+            Count<Cnt>::get(res, w, width);
+        return res;
+    }
+
+    template void write_table(std::string const&, Layout const&,
+        std::uint64_t const*, TableInfo const&);
+    template void write_table(std::string const&, Layout const&, Wide const*,
+        TableInfo const&);
+    template void write_table(std::string const&, Layout const&, Cnt const*,
+        TableInfo const&);
+
+    template void write_table(std::string const&,
+        BasicGrid<std::uint64_t> const&);
+    template void write_table(std::string const&, BasicGrid<Wide> const&);
+    template void write_table(std::string const&, BasicGrid<Cnt> const&);
+}
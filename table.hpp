@@ -0,0 +1,149 @@
+/* Copyright 2022 Aleksandr Popov
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version. This program is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General
+ * Public License for more details. You should have received a copy of the GNU
+ * General Public License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include "counts.hpp"
+#include "defs.hpp"
+#include "layout.hpp"
+
+namespace dp {
+    /*
+     * The binary table format, version 2: a table of layers 0 <= t <= T with
+     * the cells stored as in a `Layout`, in native byte order.
+     *
+     *   Header, 64 bytes: the magic "BRIDGLT\0"; u32 version; u32 flags (bit
+     *   0: folded, bit 1: time flipped, bit 2: coordinates flipped); u32 T;
+     *   i32 shift i, j; u32 width, the 64-bit words per cell; u64 rows, the
+     *   total number of rows; u64 cells, the total number of cells; u64
+     *   0x0102030405060708 to tell the byte order; 8 bytes of padding.
+     *   Index: i64 first row per layer (T + 1); u64 index of the first row of
+     *   every layer in the spans (T + 2); u64 first cell of every layer
+     *   (T + 2); per row, i32 lo, i32 hi and u64 offset as in `Span`.
+     *   Cells: `width` words per cell, the least significant word first.
+     *
+     * The shift and the flips are applied by the reader, as in `DP::at`.
+     */
+
+    /**
+     * How a table maps to the coordinates of its queries, see `DP`.
+     */
+    struct TableInfo {
+        /// The shift, i.e. starting position instead of (0, 0).
+        std::pair<Loc, Loc> shift{0, 0};
+        /// Whether time is flipped.
+        bool flip{false};
+        /// The factor in computing locations, -1 or 1, to flip directions.
+        Loc f{1};
+    };
+
+    /**
+     * @brief Write a table in the binary format, throwing an exception if
+     * that fails.
+     * @param path The name of the file.
+     * @param layout The layout of the table.
+     * @param cells The cells, `layout.size()` of them.
+     * @param info The shift and flips of the table.
+     */
+    template<typename C>
+    void write_table(std::string const& path, Layout const& layout,
+        C const* cells, TableInfo const& info);
+
+    /**
+     * @brief Write a grid, e.g. from `DP::flatten`, in the binary format as a
+     * table with the single layer t = 0, shifted to the centre of the grid.
+     * @param path The name of the file.
+     * @param grid The grid.
+     */
+    template<typename C>
+    void write_table(std::string const& path, BasicGrid<C> const& grid);
+
+    /**
+     * A table in the binary format, mapped into memory rather than read, so
+     * opening it takes constant time; the cells are read on access.
+     */
+    class MappedTable {
+        /// The mapped file.
+        void* base{nullptr};
+        /// The size of the mapped file.
+        std::size_t length{0};
+        /// The last layer.
+        Time T{0};
+        /// Whether coordinates are folded into the octant 0 <= j <= i.
+        bool fold{false};
+        /// The shift and flips.
+        TableInfo info;
+        /// The 64-bit words per cell.
+        std::size_t width{0};
+        /// The first row of every layer.
+        std::int64_t const* first{nullptr};
+        /// The index of the first row of every layer in `spans`.
+        std::uint64_t const* rows{nullptr};
+        /// The first cell of every layer.
+        std::uint64_t const* begin{nullptr};
+        /// The rows of all layers, in order.
+        Span const* spans{nullptr};
+        /// The cells.
+        std::uint64_t const* words{nullptr};
+
+    public:
+        /**
+         * @brief Map a file written by `write_table`; throw an exception if it
+         * cannot be read, is not in the right format or byte order, or if its
+         * index points outside of the file. The index is checked once here,
+         * in O(T + rows) time, so lookups need no checks of their own.
+         * @param path The name of the file.
+         */
+        explicit MappedTable(std::string const& path);
+
+        MappedTable(MappedTable const&) = delete;
+        MappedTable& operator=(MappedTable const&) = delete;
+
+        /**
+         * @brief Unmap the file.
+         */
+        ~MappedTable();
+
+        /**
+         * @brief The last layer T.
+         */
+        Time max_time() const;
+
+        /**
+         * @brief The number of 64-bit words per cell.
+         */
+        std::size_t cell_width() const;
+
+        /**
+         * @brief The words of the cell P(i, j, t), without copying.
+         * @param i First dimension.
+         * @param j Second dimension.
+         * @param t The time, between 0 and T.
+         * @return The `cell_width()` words of the cell, the least significant
+         * first, or `nullptr` if the cell is not stored.
+         */
+        std::uint64_t const* cell(Loc const& i, Loc const& j,
+            Time const& t) const;
+
+        /**
+         * @brief Return the value P(i, j, t), with 0 for cells that are not
+         * stored, see `DP::at`.
+         */
+        Cnt at(Loc const& i, Loc const& j, Time const& t = 0) const;
+    };
+}
+#endif